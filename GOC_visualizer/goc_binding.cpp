@@ -1,4 +1,6 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
 #include "../src/goc_game_tree.h"
 
 namespace py = pybind11;
@@ -11,10 +13,114 @@ namespace py = pybind11;
  *  - cd ..
  */
 
+/*
+ * Read-only NumPy view of a column of table.
+ * No data is copied; the array holds a reference to the table, which a new solve of the board
+ * replaces rather than frees, so the array stays valid for as long as it exists.
+ */
+template <typename T>
+py::array_t<T> table_view(shared_ptr<const GOC::NimberTable> table, const vector<T>& column) {
+    py::capsule owner(new shared_ptr<const GOC::NimberTable>(table), [](void* p) {
+        delete static_cast<shared_ptr<const GOC::NimberTable>*>(p);
+    });
+    py::array_t<T> a(column.size(), column.data(), owner);
+    a.attr("setflags")(py::arg("write") = false);
+    return a;
+}
+
 PYBIND11_MODULE(game_of_cycles, handle) {
     handle.doc() = "Game of Cycles Class.";
 
+    py::enum_<GOC::SolveStage>(handle, "SolveStage")
+        .value("IDLE", GOC::IDLE)
+        .value("BUILDING_TREE", GOC::BUILDING_TREE)
+        .value("NORMAL_NIMBERS", GOC::NORMAL_NIMBERS)
+        .value("MISERE_NIMBERS", GOC::MISERE_NIMBERS)
+        .value("DONE", GOC::DONE)
+        .value("CANCELLED", GOC::CANCELLED);
+
+    py::class_<GOC::SolveStatus>(handle, "SolveStatus")
+        .def_readonly("stage", &GOC::SolveStatus::stage)
+        .def_readonly("levels_done", &GOC::SolveStatus::levels_done)
+        .def_readonly("states_discovered", &GOC::SolveStatus::states_discovered)
+        .def_readonly("states_remaining", &GOC::SolveStatus::states_remaining);
+
+    py::class_<GOC::LevelStats>(handle, "LevelStats")
+        .def_readonly("states", &GOC::LevelStats::states)
+        .def_readonly("end_states", &GOC::LevelStats::end_states)
+        .def_readonly("norm_p_positions", &GOC::LevelStats::norm_p_positions)
+        .def_readonly("mis_p_positions", &GOC::LevelStats::mis_p_positions)
+        .def_readonly("norm_nimbers", &GOC::LevelStats::norm_nimbers)
+        .def_readonly("mis_nimbers", &GOC::LevelStats::mis_nimbers);
+
+    py::class_<GOC::SolveHandle>(handle, "SolveHandle")
+        .def("ready", &GOC::SolveHandle::ready)
+        .def("wait", &GOC::SolveHandle::wait, py::call_guard<py::gil_scoped_release>())
+        .def("cancel", &GOC::SolveHandle::cancel)
+        .def("status", &GOC::SolveHandle::status);
+
+    // solver entry points release the GIL so a UI thread can keep running during long solves
     py::class_<GOC>(handle, "pyGOC")
         .def(py::init<string&>())
-        .def("name", &GOC::name);
-}
\ No newline at end of file
+        .def("name", &GOC::name)
+        .def("compute_tree", &GOC::compute_tree, py::call_guard<py::gil_scoped_release>())
+        .def("mex_rule_normal", &GOC::mex_rule_normal, py::call_guard<py::gil_scoped_release>())
+        .def("mex_rule_misere", &GOC::mex_rule_misere, py::call_guard<py::gil_scoped_release>())
+        .def("solve_async", [](py::object self, py::object on_progress) {
+                GOC& board = self.cast<GOC&>();
+                // the worker holds the board and the callable until it exits, so the board is never
+                // destroyed (which waits for the worker) while the worker waits for the GIL;
+                // both are released on the worker thread, so their last references must drop under the GIL
+                bool has_callback = !on_progress.is_none();
+                shared_ptr<pair<py::object, py::object>> refs(new pair<py::object, py::object>(self, on_progress),
+                    [](pair<py::object, py::object>* p) {
+                        py::gil_scoped_acquire acquire;
+                        delete p;
+                    });
+                GOC::ProgressCallback callback = [refs, has_callback](const GOC::SolveStatus& status) {
+                    if (has_callback) {
+                        py::gil_scoped_acquire acquire;
+                        refs->second(status);
+                    }
+                };
+                return board.solve_async(callback);
+            },
+            py::arg("on_progress") = py::none(), py::keep_alive<0, 1>(),
+            "Builds the tree and both nimber tables on a worker thread; returns a SolveHandle.\n"
+            "on_progress(status) is called from the worker after every level. Nimber lookups\n"
+            "return -1 until the level of the queried state is finished.")
+        .def("solve_status", &GOC::solve_status)
+        .def("compute_nimber", &GOC::compute_nimber, py::arg("normal_play") = true,
+             py::call_guard<py::gil_scoped_release>(),
+             "Nimber of the empty board, solved depth-first without building the game tree.")
+        .def("set_memo_capacity", &GOC::set_memo_capacity, py::arg("entries"),
+             "Bounds the depth-first solver's memo tables (0 = unbounded).")
+        .def("compute_outcome", &GOC::compute_outcome, py::arg("normal_play") = true,
+             py::call_guard<py::gil_scoped_release>(),
+             "Whether the first player wins, searched without computing nimbers.")
+        .def("outcome", &GOC::hash_to_outcome, py::arg("h"), py::arg("normal_play") = true,
+             py::call_guard<py::gil_scoped_release>(),
+             "1 if state h is an n-position, 0 if a p-position, -1 if h is not reachable.")
+        .def("hash_to_norm_nimber", &GOC::hash_to_norm_nimber, py::arg("h"))
+        .def("hash_to_mis_nimber", &GOC::hash_to_mis_nimber, py::arg("h"))
+        .def("p_moves", &GOC::hash_to_p_moves, py::arg("h"), py::arg("normal_play") = true,
+             "List of (edge, orientation) moves from state h to a p-position.")
+        .def("level_stats", &GOC::level_stats,
+             "Per-level LevelStats (states, end states, p-positions, nimber counts) of the last solve;\n"
+             "levels appear as a running solve finishes them.")
+        .def("export_nimbers", [](GOC& board) {
+                {
+                    py::gil_scoped_release release;
+                    board.tabulate_nimbers();
+                }
+                shared_ptr<const GOC::NimberTable> table = board.nimber_table();
+                return py::make_tuple(table_view(table, table->hashes),
+                                      table_view(table, table->levels),
+                                      table_view(table, table->norm_nimbers),
+                                      table_view(table, table->mis_nimbers));
+            },
+            "(hashes, levels, normal nimbers, misere nimbers) of every state, in level order.\n"
+            "Arrays are read-only views of the board's nimber table; calling again refreshes the\n"
+            "nimber columns in place. After a new solve the board starts a new table: earlier\n"
+            "arrays stay valid but keep the values they had. Raises ValueError while a solve runs.");
+}
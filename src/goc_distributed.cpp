@@ -0,0 +1,401 @@
+#include "goc_game_tree.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <unordered_map>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Multi-process solver (GOC::solve_distributed).
+ *
+ * Every state is owned by one worker process, chosen from its hash. All messages go through the
+ * coordinator (the calling process), which forwards what worker i addressed to worker j:
+ *  - forward, per level: each worker expands its states and sends every child hash to the child's
+ *    owner. Owners remember which workers asked for a state; those are its parents' owners.
+ *  - backward, per level from the deepest: each worker evaluates its states by the mex rule and
+ *    sends (hash, normal nimber, misere nimber) to the workers that asked for them, plus
+ *    (hash, normal nimber, misere nimber, end state) to the coordinator for the final table and
+ *    the level statistics.
+ * A worker writes all its messages for a step before reading, and the coordinator reads every
+ * worker's messages before forwarding, so blocking pipes cannot deadlock.
+ */
+
+namespace {
+
+/*
+ * Largest number of workers; requesting workers are kept as a 64-bit mask per state.
+ */
+const int MAX_WORKERS = 64;
+
+void write_all(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw runtime_error("solve_distributed: write to worker pipe failed");
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+void read_all(int fd, void* data, size_t len) {
+    char* p = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw runtime_error("solve_distributed: worker pipe closed unexpectedly");
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/*
+ * A message is a length-prefixed array of ints.
+ */
+void send_message(int fd, const vector<int>& msg) {
+    uint64_t n = msg.size();
+    write_all(fd, &n, sizeof(n));
+    if (n > 0) {
+        write_all(fd, msg.data(), n * sizeof(int));
+    }
+}
+
+vector<int> receive_message(int fd) {
+    uint64_t n;
+    read_all(fd, &n, sizeof(n));
+    vector<int> msg = vector<int>(n);
+    if (n > 0) {
+        read_all(fd, &msg[0], n * sizeof(int));
+    }
+    return msg;
+}
+
+/*
+ * Worker owning the state with hash h.
+ * Ternary hashes are far from uniform, so they are mixed before reducing to [0, num_workers).
+ */
+int owner(int h, int num_workers) {
+    uint32_t mixed = uint32_t(h) * 2654435769u;
+    return int((uint64_t(mixed) * num_workers) >> 32);
+}
+
+/*
+ * A state owned by a worker.
+ */
+struct OwnedState {
+    int hash;
+    uint64_t requesters;    // workers owning a parent of this state
+    vector<int> children;
+    int norm_nimber;
+    int mis_nimber;
+};
+
+}
+
+void GOC::solve_distributed(int num_workers) {
+    if (num_workers < 1 || num_workers > MAX_WORKERS) {
+        throw invalid_argument("Number of workers must be between 1 and " + to_string(MAX_WORKERS) + ".");
+    }
+    require_idle();
+    cout << "computing nimbers with " << num_workers << " worker processes..." << endl;
+
+    clear_tree();
+
+    // a worker dying must surface as an error here, not kill this process
+    void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+    cout.flush();
+
+    vector<int> to_worker = vector<int>(num_workers, -1);
+    vector<int> from_worker = vector<int>(num_workers, -1);
+    vector<pid_t> pids;
+    shared_ptr<NimberTable> table;
+    vector<LevelStats> level_stats;
+    try {
+        for (int i = 0; i < num_workers; i++) {
+            int down[2];
+            int up[2];
+            if (pipe(down) != 0 || pipe(up) != 0) {
+                throw runtime_error("solve_distributed: unable to create pipes");
+            }
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw runtime_error("solve_distributed: unable to start worker process");
+            }
+            if (pid == 0) {     // worker
+                close(down[1]);
+                close(up[0]);
+                for (int j = 0; j < i; j++) {
+                    close(to_worker[j]);
+                    close(from_worker[j]);
+                }
+                int status = 0;
+                try {
+                    distributed_worker(i, num_workers, down[0], up[1]);
+                } catch (...) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            pids.push_back(pid);
+            close(down[0]);
+            close(up[1]);
+            to_worker[i] = down[1];
+            from_worker[i] = up[0];
+        }
+
+        // forward: route frontier states until no worker produces new ones
+        int num_levels = 1;
+        while (true) {
+            vector<vector<vector<int>>> routed = vector<vector<vector<int>>>(num_workers);
+            int total = 0;
+            for (int i = 0; i < num_workers; i++) {
+                for (int j = 0; j < num_workers; j++) {
+                    routed[i].push_back(receive_message(from_worker[i]));
+                    total += routed[i][j].size();
+                }
+            }
+            for (int j = 0; j < num_workers; j++) {
+                send_message(to_worker[j], vector<int>(1, total));
+                for (int i = 0; i < num_workers; i++) {
+                    send_message(to_worker[j], routed[i][j]);
+                }
+            }
+            if (total == 0) {
+                break;
+            }
+            num_levels++;
+        }
+
+        // backward: route nimbers level by level and collect each worker's results
+        vector<vector<int>> results;    // per level: (hash, normal, misere, end state) rows
+        for (int level = num_levels-1; level >= 0; level--) {
+            vector<vector<vector<int>>> routed = vector<vector<vector<int>>>(num_workers);
+            vector<int> level_results;
+            for (int i = 0; i < num_workers; i++) {
+                for (int j = 0; j < num_workers; j++) {
+                    routed[i].push_back(receive_message(from_worker[i]));
+                }
+                vector<int> r = receive_message(from_worker[i]);
+                level_results.insert(level_results.end(), r.begin(), r.end());
+            }
+            for (int j = 0; j < num_workers; j++) {
+                for (int i = 0; i < num_workers; i++) {
+                    send_message(to_worker[j], routed[i][j]);
+                }
+            }
+            results.push_back(level_results);
+        }
+
+        // end state counts
+        for (int i = 0; i < num_workers; i++) {
+            vector<int> counts = receive_message(from_worker[i]);
+            num_end_states_ += counts[0];
+            p1_wins_ += counts[1];
+            p2_wins_ += counts[2];
+        }
+
+        // nimber table, sorted by (level, hash) for table_nimber, and level statistics
+        table = shared_ptr<NimberTable>(new NimberTable());
+        level_stats.resize(num_levels);
+        for (int level = 0; level < num_levels; level++) {
+            vector<int>& r = results[num_levels-1-level];
+            LevelStats& stats = level_stats[level];
+            vector<pair<int, size_t>> order;
+            for (size_t k = 0; k < r.size(); k += 4) {
+                order.push_back(pair<int, size_t>(r[k], k));
+
+                int norm = r[k+1];
+                int mis = r[k+2];
+                stats.states++;
+                stats.end_states += r[k+3];
+                stats.norm_p_positions += (norm == 0);
+                stats.mis_p_positions += (mis == 0);
+                if (norm >= int(stats.norm_nimbers.size())) {
+                    stats.norm_nimbers.resize(norm+1);
+                }
+                stats.norm_nimbers[norm]++;
+                if (mis >= int(stats.mis_nimbers.size())) {
+                    stats.mis_nimbers.resize(mis+1);
+                }
+                stats.mis_nimbers[mis]++;
+            }
+            sort(order.begin(), order.end());
+            for (auto row : order) {
+                table->hashes.push_back(row.first);
+                table->levels.push_back(level);
+                table->norm_nimbers.push_back(r[row.second+1]);
+                table->mis_nimbers.push_back(r[row.second+2]);
+            }
+        }
+    } catch (...) {
+        for (int i = 0; i < num_workers; i++) {
+            if (to_worker[i] != -1) {
+                close(to_worker[i]);
+                close(from_worker[i]);
+            }
+        }
+        for (pid_t pid : pids) {
+            waitpid(pid, NULL, 0);
+        }
+        signal(SIGPIPE, old_sigpipe);
+        throw;
+    }
+
+    bool failed = false;
+    for (int i = 0; i < num_workers; i++) {
+        close(to_worker[i]);
+        close(from_worker[i]);
+        int status;
+        if (waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = true;
+        }
+    }
+    signal(SIGPIPE, old_sigpipe);
+    if (failed) {
+        throw runtime_error("solve_distributed: a worker process failed");
+    }
+
+    atomic_store(&table_, table);
+    {
+        lock_guard<mutex> lock(progress_->stats_lock);
+        level_stats_.swap(level_stats);
+    }
+    progress_->states_discovered.store(table->hashes.size());
+    progress_->norm_ready_level.store(0);
+    progress_->mis_ready_level.store(0);
+    progress_->table_ready.store(true, memory_order_release);
+
+    cout << "...nimbers evaluated\n" << endl;
+}
+
+void GOC::distributed_worker(int id, int num_workers, int in_fd, int out_fd) {
+    vector<vector<OwnedState>> levels;
+    levels.push_back(vector<OwnedState>());
+    if (owner(0, num_workers) == id) {     // empty board
+        OwnedState root = { 0, 0, vector<int>(), -1, -1 };
+        levels[0].push_back(root);
+    }
+    int end_states = 0;
+    int p1_wins = 0;
+    int p2_wins = 0;
+
+    // forward: expand own states of the current level, send children to their owners
+    while (true) {
+        vector<vector<int>> out = vector<vector<int>>(num_workers);
+        for (OwnedState& owned : levels.back()) {
+            State s;
+            state_from_hash(owned.hash, &s);
+            vector<pair<short int, bool>> next_moves = legal_moves(s);
+            if (next_moves.empty()) {   // end state (cycle made or no moves left)
+                end_states++;
+                if (s.turn % 2 == 0) {
+                    p2_wins++;
+                } else {
+                    p1_wins++;
+                }
+                continue;
+            }
+            for (auto move : next_moves) {
+                int h = owned.hash + move_hash(move);
+                owned.children.push_back(h);
+                out[owner(h, num_workers)].push_back(h);
+            }
+        }
+        for (int j = 0; j < num_workers; j++) {
+            sort(out[j].begin(), out[j].end());
+            out[j].erase(unique(out[j].begin(), out[j].end()), out[j].end());
+            send_message(out_fd, out[j]);
+        }
+
+        int total = receive_message(in_fd)[0];
+        vector<OwnedState> next_level;
+        unordered_map<int, size_t> index;
+        for (int i = 0; i < num_workers; i++) {
+            for (int h : receive_message(in_fd)) {
+                unordered_map<int, size_t>::iterator it = index.find(h);
+                if (it == index.end()) {
+                    it = index.insert(pair<int, size_t>(h, next_level.size())).first;
+                    OwnedState child = { h, 0, vector<int>(), -1, -1 };
+                    next_level.push_back(child);
+                }
+                next_level[it->second].requesters |= uint64_t(1) << i;
+            }
+        }
+        if (total == 0) {
+            break;
+        }
+        levels.push_back(next_level);
+    }
+
+    // backward: mex rule on own states, children's nimbers arrive from their owners
+    unordered_map<int, pair<int, int>> child_nimbers;
+    for (int level = int(levels.size())-1; level >= 0; level--) {
+        vector<vector<int>> out = vector<vector<int>>(num_workers);
+        vector<int> results;
+        for (OwnedState& owned : levels[level]) {
+            if (owned.children.empty()) {
+                owned.norm_nimber = 0;
+                owned.mis_nimber = 1;
+            } else {
+                // mex is at most n; as in mex_rule
+                int n = owned.children.size();
+                vector<bool> seen_norm = vector<bool>(n+1);
+                vector<bool> seen_mis = vector<bool>(n+1);
+                for (int h : owned.children) {
+                    pair<int, int> c = child_nimbers.at(h);
+                    if (c.first < n) {
+                        seen_norm[c.first] = true;
+                    }
+                    if (c.second < n) {
+                        seen_mis[c.second] = true;
+                    }
+                }
+                owned.norm_nimber = 0;
+                while (seen_norm[owned.norm_nimber]) {
+                    owned.norm_nimber++;
+                }
+                owned.mis_nimber = 0;
+                while (seen_mis[owned.mis_nimber]) {
+                    owned.mis_nimber++;
+                }
+            }
+
+            int row[4] = { owned.hash, owned.norm_nimber, owned.mis_nimber, owned.children.empty() };
+            for (int j = 0; j < num_workers; j++) {
+                if (owned.requesters & (uint64_t(1) << j)) {
+                    out[j].insert(out[j].end(), row, row+3);
+                }
+            }
+            results.insert(results.end(), row, row+4);
+        }
+        // only the nimbers sent on are needed from here on
+        vector<OwnedState>().swap(levels[level]);
+
+        for (int j = 0; j < num_workers; j++) {
+            send_message(out_fd, out[j]);
+        }
+        send_message(out_fd, results);
+
+        child_nimbers.clear();
+        for (int i = 0; i < num_workers; i++) {
+            vector<int> msg = receive_message(in_fd);
+            for (size_t k = 0; k < msg.size(); k += 3) {
+                child_nimbers[msg[k]] = pair<int, int>(msg[k+1], msg[k+2]);
+            }
+        }
+    }
+
+    int counts[3] = { end_states, p1_wins, p2_wins };
+    send_message(out_fd, vector<int>(counts, counts+3));
+}
@@ -0,0 +1,471 @@
+#include "goc_game_tree.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+/*
+ * Differential test of the solvers (make fuzz).
+ *
+ * Random boards are built as plane graphs whose bounded faces are exactly the cells: starting from a
+ * polygon, cells are split by chords, edges subdivided, triangles grown on edges of the outer face and
+ * pendant tails attached. Edge directions are random, so cells mix both orientations.
+ * The resulting encodings go through parse_encoding like any board file.
+ *
+ * The reference is SolverFuzz::reference_nimbers, a plain depth-first mex over GOC::State using
+ * legal_moves, take_turn and undo_turn, which share no code with the board kernels the optimized
+ * solvers run on. Those run twice per board, on BoardKernel<uint16_t> and, forced through
+ * GOC::wide_kernel_, on BoardKernel<uint32_t>.
+ */
+
+namespace {
+
+/*
+ * Board under construction: edges (u,v), and cells as closed walks of (edge, traversed from u to v) steps.
+ */
+struct RandomBoard {
+    int num_vertices;
+    vector<pair<int, int>> edges;
+    vector<vector<pair<int, bool>>> cells;
+};
+
+int start_vertex(const RandomBoard& b, pair<int, bool> step) {
+    return step.second ? b.edges[step.first].first : b.edges[step.first].second;
+}
+
+/*
+ * Adds an edge between u and v in a random direction; returns the step which traverses it from u to v.
+ */
+pair<int, bool> add_edge(RandomBoard& b, int u, int v, mt19937& rng) {
+    bool forward = rng() % 2 == 0;
+    b.edges.push_back(forward ? pair<int, int>(u, v) : pair<int, int>(v, u));
+    return pair<int, bool>(b.edges.size()-1, forward);
+}
+
+/*
+ * Number of cells bordering each edge; 1 for edges of the outer face, 0 for tails.
+ */
+vector<int> cell_counts(const RandomBoard& b) {
+    vector<int> counts = vector<int>(b.edges.size());
+    for (auto& cell : b.cells) {
+        for (auto step : cell) {
+            counts[step.first]++;
+        }
+    }
+    return counts;
+}
+
+RandomBoard random_board(mt19937& rng, int max_edges) {
+    RandomBoard b;
+    int target = 3 + rng() % (max_edges-2);
+
+    b.num_vertices = (target >= 4 && rng() % 2 == 0) ? 4 : 3;
+    vector<pair<int, bool>> polygon;
+    for (int v = 0; v < b.num_vertices; v++) {
+        polygon.push_back(add_edge(b, v, (v+1) % b.num_vertices, rng));
+    }
+    b.cells.push_back(polygon);
+
+    while (int(b.edges.size()) < target) {
+        int op = rng() % 8;
+        if (op < 3) {               // split a cell by a chord
+            int c = rng() % b.cells.size();
+            vector<pair<int, bool>> walk = b.cells[c];
+            int len = walk.size();
+            if (len < 4) {
+                continue;
+            }
+            // chord from the start of step 0 to the start of step k, 2 <= k <= len-2
+            rotate(walk.begin(), walk.begin() + rng() % len, walk.end());
+            int k = 2 + rng() % (len-3);
+            pair<int, bool> chord = add_edge(b, start_vertex(b, walk[0]), start_vertex(b, walk[k]), rng);
+            vector<pair<int, bool>> first = vector<pair<int, bool>>(walk.begin(), walk.begin()+k);
+            first.push_back(pair<int, bool>(chord.first, !chord.second));
+            vector<pair<int, bool>> second = vector<pair<int, bool>>(walk.begin()+k, walk.end());
+            second.push_back(chord);
+            b.cells[c] = first;
+            b.cells.push_back(second);
+        } else if (op < 5) {        // subdivide an edge: (u,v) becomes (u,w), (w,v)
+            int e = rng() % b.edges.size();
+            int w = b.num_vertices++;
+            int v = b.edges[e].second;
+            b.edges[e].second = w;
+            b.edges.push_back(pair<int, int>(w, v));
+            int g = b.edges.size()-1;
+            for (auto& cell : b.cells) {
+                for (size_t s = 0; s < cell.size(); s++) {
+                    if (cell[s].first != e) {
+                        continue;
+                    }
+                    if (cell[s].second) {
+                        cell.insert(cell.begin()+s+1, pair<int, bool>(g, true));
+                    } else {
+                        cell.insert(cell.begin()+s, pair<int, bool>(g, false));
+                    }
+                    break;
+                }
+            }
+        } else if (op < 7) {        // grow a triangle on an edge of the outer face
+            if (int(b.edges.size())+2 > target) {
+                continue;
+            }
+            vector<int> counts = cell_counts(b);
+            vector<int> outer;
+            for (int e = 0; e < int(b.edges.size()); e++) {
+                if (counts[e] == 1) {
+                    outer.push_back(e);
+                }
+            }
+            int e = outer[rng() % outer.size()];
+            bool forward = false;
+            for (auto& cell : b.cells) {
+                for (auto step : cell) {
+                    if (step.first == e) {
+                        forward = step.second;
+                    }
+                }
+            }
+            // the new cell traverses e the other way, from p to q
+            pair<int, bool> back = pair<int, bool>(e, !forward);
+            int p = start_vertex(b, back);
+            int q = start_vertex(b, pair<int, bool>(e, forward));
+            int w = b.num_vertices++;
+            vector<pair<int, bool>> triangle;
+            triangle.push_back(back);
+            triangle.push_back(add_edge(b, q, w, rng));
+            triangle.push_back(add_edge(b, w, p, rng));
+            b.cells.push_back(triangle);
+        } else {                    // pendant tail at a vertex of the outer face
+            vector<int> counts = cell_counts(b);
+            vector<int> outer;
+            for (int e = 0; e < int(b.edges.size()); e++) {
+                if (counts[e] <= 1) {
+                    outer.push_back(e);
+                }
+            }
+            int e = outer[rng() % outer.size()];
+            int v = rng() % 2 == 0 ? b.edges[e].first : b.edges[e].second;
+            add_edge(b, v, b.num_vertices++, rng);
+        }
+    }
+
+    return b;
+}
+
+string encoding(const RandomBoard& b, const string& name) {
+    ostringstream out;
+    out << name << "\n" << b.num_vertices << " " << b.edges.size() << "\nEDGES\n";
+    for (auto edge : b.edges) {
+        out << edge.first << " " << edge.second << "\n";
+    }
+    out << "CYCLES\n";
+    for (auto& cell : b.cells) {
+        for (size_t s = 0; s < cell.size(); s++) {
+            out << (s > 0 ? " " : "") << (cell[s].second ? "+" : "-") << cell[s].first;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+bool same_stats(const vector<GOC::LevelStats>& a, const vector<GOC::LevelStats>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t level = 0; level < a.size(); level++) {
+        if (a[level].states != b[level].states || a[level].end_states != b[level].end_states ||
+            a[level].norm_p_positions != b[level].norm_p_positions ||
+            a[level].mis_p_positions != b[level].mis_p_positions ||
+            a[level].norm_nimbers != b[level].norm_nimbers || a[level].mis_nimbers != b[level].mis_nimbers) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Solvers compared by the test, in the order they run on each board. The ones after DISTRIBUTED
+ * run on a board kernel, once per kernel width.
+ */
+enum Engine { REFERENCE, DISTRIBUTED, TREE, ASYNC, DEPTH_FIRST, BOUNDED, OUTCOME, NUM_ENGINES };
+
+const char* const ENGINE_NAMES[NUM_ENGINES] = {
+    "reference", "distributed (2)", "tree + mex", "solve_async", "depth-first", "bounded memo (1024)", "outcome"
+};
+
+const char* const KERNEL_NAMES[2] = { "16-bit", "32-bit" };
+
+}
+
+/*
+ * Runs the test; friend of GOC.
+ */
+class SolverFuzz {
+public:
+    /*
+     * Compares the solvers on num_boards random plane boards of at most max_edges edges: every
+     * state's nimbers from the tree + mex rule, solve_async, solve_distributed and the depth-first
+     * solver (unbounded and bounded memo), every outcome from compute_outcome, and the level
+     * statistics are compared with reference_nimbers. Prints each mismatch with the board's
+     * encoding, then the throughput of each solver. Returns the number of boards with mismatches.
+     */
+    static int run(int num_boards, unsigned int seed, int max_edges);
+
+private:
+    /*
+     * The normal and misere nimbers of s and of every state below it, found depth-first with
+     * legal_moves/take_turn, are stored in nimbers by hash along with whether the state is an
+     * end state. Returns the nimbers of s.
+     */
+    static pair<int, int> reference_nimbers(GOC& board, GOC::State* s, map<int, pair<pair<int, int>, bool>>& nimbers);
+};
+
+int SolverFuzz::run(int num_boards, unsigned int seed, int max_edges) {
+    if (max_edges < 3) {
+        throw invalid_argument("fuzz: boards need at least 3 edges.");
+    }
+
+    mt19937 rng(seed);
+    double seconds[2][NUM_ENGINES] = {};     // per kernel width
+    long long total_states = 0;
+    int failed_boards = 0;
+
+    for (int i = 0; i < num_boards; i++) {
+        RandomBoard rb = random_board(rng, max_edges);
+        string name = "fuzz " + to_string(seed) + "/" + to_string(i);
+        string text = encoding(rb, name);
+        vector<string> failures;
+
+        // solvers report progress on cout; only the results are of interest here
+        streambuf* console = cout.rdbuf(NULL);
+        try {
+            GOC board;
+            board.parse_encoding(text.data(), text.size(), name);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            Engine engine = REFERENCE;
+            int wide = 0;
+            auto lap = [&]() {
+                chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                seconds[wide][engine] += chrono::duration<double>(now - start).count();
+                start = now;
+            };
+            auto engine_name = [&]() {
+                return string(ENGINE_NAMES[engine]) + (engine > DISTRIBUTED ? string(" (") + KERNEL_NAMES[wide] + ")" : "");
+            };
+
+            map<int, pair<pair<int, int>, bool>> ref;
+            GOC::State root = GOC::State();
+            root.markings = vector<short int>(board.edges_.size());
+            root.outgoing_edges = vector<short int>(board.vertex_degrees_.size());
+            reference_nimbers(board, &root, ref);
+            lap();
+            total_states += ref.size();
+
+            // level statistics implied by the reference
+            vector<GOC::LevelStats> ref_stats;
+            for (auto& row : ref) {
+                size_t level = 0;
+                for (int d = row.first; d > 0; d /= 3) {
+                    level += (d % 3 != 0);
+                }
+                if (level >= ref_stats.size()) {
+                    ref_stats.resize(level+1);
+                }
+                GOC::LevelStats& stats = ref_stats[level];
+                int norm = row.second.first.first;
+                int mis = row.second.first.second;
+                stats.states++;
+                stats.end_states += row.second.second;
+                stats.norm_p_positions += (norm == 0);
+                stats.mis_p_positions += (mis == 0);
+                if (norm >= int(stats.norm_nimbers.size())) {
+                    stats.norm_nimbers.resize(norm+1);
+                }
+                stats.norm_nimbers[norm]++;
+                if (mis >= int(stats.mis_nimbers.size())) {
+                    stats.mis_nimbers.resize(mis+1);
+                }
+                stats.mis_nimbers[mis]++;
+            }
+
+            // first differing state of the current engine, if any
+            auto compare = [&](function<pair<int, int>(int)> nimbers, size_t num_states) {
+                if (num_states != ref.size()) {
+                    failures.push_back(engine_name() + ": " + to_string(num_states) +
+                                       " states, expected " + to_string(ref.size()));
+                    return;
+                }
+                for (auto& row : ref) {
+                    pair<int, int> got = nimbers(row.first);
+                    if (got != row.second.first) {
+                        failures.push_back(engine_name() + ": state " + board.to_base_3(row.first) +
+                                           " has nimbers " + to_string(got.first) + "/" + to_string(got.second) +
+                                           ", expected " + to_string(row.second.first.first) + "/" +
+                                           to_string(row.second.first.second));
+                        return;
+                    }
+                }
+            };
+            auto compare_stats = [&]() {
+                if (!same_stats(board.level_stats(), ref_stats)) {
+                    failures.push_back(engine_name() + ": level statistics differ");
+                }
+            };
+            auto lookup = [&](int h) {
+                return pair<int, int>(board.hash_to_norm_nimber(h), board.hash_to_mis_nimber(h));
+            };
+
+            engine = DISTRIBUTED;
+            start = chrono::steady_clock::now();
+            board.solve_distributed(2);
+            lap();
+            compare(lookup, board.nimber_table()->hashes.size());
+            compare_stats();
+
+            // the remaining solvers on each kernel; boards of more than 16 edges only fit the wide one
+            for (wide = 0; wide < 2; wide++) {
+                board.wide_kernel_ = wide == 1;
+                if (board.narrow_kernel() == board.wide_kernel_) {
+                    continue;
+                }
+
+                engine = TREE;
+                start = chrono::steady_clock::now();
+                board.compute_tree();
+                board.mex_rule_normal();
+                board.mex_rule_misere();
+                lap();
+                compare(lookup, board.tree_->hash_to_node.size());
+                compare_stats();
+
+                engine = ASYNC;
+                start = chrono::steady_clock::now();
+                board.solve_async().wait();
+                lap();
+                compare(lookup, board.tree_->hash_to_node.size());
+
+                // states are rebuilt outside the timed part, so only the searches are measured
+                auto search = [&](Engine e) {
+                    engine = e;
+                    board.hint_deadline_ = chrono::steady_clock::time_point::max();
+                    map<int, pair<int, int>> found;
+                    GOC::State s;
+                    for (auto& row : ref) {
+                        board.state_from_hash(row.first, &s);
+                        start = chrono::steady_clock::now();
+                        pair<int, int> nimbers = pair<int, int>(board.lazy_nimber(&s, true), board.lazy_nimber(&s, false));
+                        lap();
+                        found[row.first] = nimbers;
+                    }
+                    compare([&](int h) { return found[h]; }, found.size());
+                };
+                board.set_memo_capacity(0);
+                search(DEPTH_FIRST);
+                board.set_memo_capacity(1024);
+                search(BOUNDED);
+
+                // outcomes only tell whether a nimber is 0
+                engine = OUTCOME;
+                board.norm_outcomes_ = GOC::OutcomeTable();
+                board.mis_outcomes_ = GOC::OutcomeTable();
+                start = chrono::steady_clock::now();
+                map<int, pair<int, int>> outcomes;
+                for (auto& row : ref) {
+                    outcomes[row.first] = pair<int, int>(board.hash_to_outcome(row.first, true),
+                                                         board.hash_to_outcome(row.first, false));
+                }
+                lap();
+                for (auto& row : ref) {
+                    pair<int, int> expected = pair<int, int>(row.second.first.first != 0, row.second.first.second != 0);
+                    if (outcomes[row.first] != expected) {
+                        failures.push_back(engine_name() + ": state " + board.to_base_3(row.first) +
+                                           " has outcomes " + to_string(outcomes[row.first].first) + "/" +
+                                           to_string(outcomes[row.first].second) + ", expected " +
+                                           to_string(expected.first) + "/" + to_string(expected.second));
+                        break;
+                    }
+                }
+            }
+        } catch (exception& ex) {
+            failures.push_back(string("error: ") + ex.what());
+        }
+        cout.rdbuf(console);
+        cout.clear();
+
+        if (!failures.empty()) {
+            failed_boards++;
+            cout << "MISMATCH on board " << i << ":" << endl;
+            for (auto& failure : failures) {
+                cout << "  " << failure << endl;
+            }
+            cout << text << endl;
+        }
+    }
+
+    cout << "fuzzed " << num_boards << " boards (seed " << seed << ", at most " << max_edges << " edges), "
+         << total_states << " states: ";
+    if (failed_boards == 0) {
+        cout << "all solvers agree" << endl;
+    } else {
+        cout << failed_boards << " boards with mismatches" << endl;
+    }
+    cout << "solver               states/s (16-bit)  states/s (32-bit)" << endl;
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        cout << left << setw(20) << ENGINE_NAMES[e] << right;
+        for (int w = 0; w < (e > DISTRIBUTED ? 2 : 1); w++) {
+            cout << setw(19);
+            if (seconds[w][e] > 0) {
+                cout << (long long)(total_states / seconds[w][e]);
+            } else {
+                cout << "-";
+            }
+        }
+        cout << endl;
+    }
+    cout << endl;
+
+    return failed_boards;
+}
+
+pair<int, int> SolverFuzz::reference_nimbers(GOC& board, GOC::State* s, map<int, pair<pair<int, int>, bool>>& nimbers) {
+    map<int, pair<pair<int, int>, bool>>::iterator it = nimbers.find(s->hash);
+    if (it != nimbers.end()) {
+        return it->second.first;
+    }
+
+    pair<int, int> nimber = pair<int, int>(0, 1);  // end state
+    vector<pair<short int, bool>> next_moves = board.legal_moves(*s);
+    if (!next_moves.empty()) {
+        set<int> norm;
+        set<int> mis;
+        for (auto move : next_moves) {
+            board.take_turn(move, s);
+            pair<int, int> c = reference_nimbers(board, s, nimbers);
+            board.undo_turn(move, s);
+            norm.insert(c.first);
+            mis.insert(c.second);
+        }
+        nimber = pair<int, int>(0, 0);
+        while (norm.count(nimber.first)) {
+            nimber.first++;
+        }
+        while (mis.count(nimber.second)) {
+            nimber.second++;
+        }
+    }
+
+    nimbers[s->hash] = pair<pair<int, int>, bool>(nimber, next_moves.empty());
+    return nimber;
+}
+
+int main(int argc, char** argv) {
+    // compare all solvers on argv[1] random boards (seed argv[2], at most argv[3] edges)
+    int num_boards = argc > 1 ? atoi(argv[1]) : 100;
+    unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+    int max_edges = argc > 3 ? atoi(argv[3]) : 9;
+
+    return SolverFuzz::run(num_boards, seed, max_edges) == 0 ? 0 : 1;
+}
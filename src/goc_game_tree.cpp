@@ -1,144 +1,625 @@
 #include "goc_game_tree.h"
+#include "goc_kernel.h"
+
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+
+namespace {
+
+/*
+ * Largest edge count whose ternary state hash still fits in an int (3^19 < 2^31).
+ */
+const int MAX_EDGES = 19;
+static_assert(MAX_EDGES <= BoardKernel<uint32_t>::MAX_EDGES, "largest board must fit a solver kernel");
+
+/*
+ * Reads an entire file into buf, reusing its capacity.
+ */
+void read_file(const string& path, string& buf) {
+    ifstream in(path, ios::in | ios::binary);
+    if (!in.is_open()) {
+        throw invalid_argument("Unable to open " + path);
+    }
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    in.seekg(0, ios::beg);
+    buf.resize(size_t(size));
+    if (size > 0) {
+        in.read(&buf[0], size);
+    }
+}
+
+/*
+ * Cursor over an in-memory encoding.
+ * Tracks line/column so formatting errors point at the offending character.
+ */
+class EncodingReader {
+public:
+    EncodingReader(const char* buf, size_t len, const string& source)
+        : buf_(buf), len_(len), pos_(0), line_(1), col_(1), source_(source) { /* nothing */ }
+
+    int line() const { return line_; }
+    int col() const { return col_; }
+
+    bool at_end() const { return pos_ >= len_; }
+
+    bool at_eol() const {
+        return at_end() || buf_[pos_] == '\n' || buf_[pos_] == '\r';
+    }
+
+    char peek() const { return buf_[pos_]; }
+
+    void advance() {
+        pos_++;
+        col_++;
+    }
+
+    void skip_blanks() {
+        while (!at_end() && (buf_[pos_] == ' ' || buf_[pos_] == '\t')) {
+            advance();
+        }
+    }
+
+    /*
+     * Consumes a line terminator (\n or \r\n) if one is present.
+     */
+    void next_line() {
+        if (!at_end() && buf_[pos_] == '\r') {
+            pos_++;
+        }
+        if (!at_end() && buf_[pos_] == '\n') {
+            pos_++;
+        }
+        line_++;
+        col_ = 1;
+    }
+
+    /*
+     * Skips lines containing only whitespace.
+     */
+    void skip_blank_lines() {
+        while (true) {
+            skip_blanks();
+            if (at_end() || !at_eol()) {
+                return;
+            }
+            next_line();
+        }
+    }
+
+    /*
+     * Requires that only whitespace remains on the current line, then moves past it.
+     */
+    void expect_eol() {
+        skip_blanks();
+        if (!at_eol()) {
+            fail(string("unexpected character '") + peek() + "'");
+        }
+        next_line();
+    }
 
-GOC::GOC(string& encoding_file_path) {
+    /*
+     * Returns the remainder of the current line (without terminator) and moves past it.
+     */
+    string rest_of_line() {
+        size_t begin = pos_;
+        while (!at_eol()) {
+            advance();
+        }
+        string s(buf_ + begin, pos_ - begin);
+        next_line();
+        return s;
+    }
+
+    /*
+     * Consumes the line if it consists of exactly kw (surrounding whitespace allowed).
+     * Leaves the cursor untouched otherwise.
+     */
+    bool match_keyword(const char* kw) {
+        size_t n = strlen(kw);
+        if (len_ - pos_ < n || strncmp(buf_ + pos_, kw, n) != 0) {
+            return false;
+        }
+        size_t after = pos_ + n;
+        while (after < len_ && (buf_[after] == ' ' || buf_[after] == '\t')) {
+            after++;
+        }
+        if (after < len_ && buf_[after] != '\n' && buf_[after] != '\r') {
+            return false;
+        }
+        col_ += int(after - pos_);
+        pos_ = after;
+        next_line();
+        return true;
+    }
+
+    /*
+     * Reads a non-negative integer no larger than max.
+     */
+    int read_uint(int max, const string& what) {
+        if (at_end() || !isdigit(peek())) {
+            fail("expected " + what);
+        }
+        int line = line_;
+        int col = col_;
+        long v = 0;
+        while (!at_end() && isdigit(peek())) {
+            v = v*10 + (peek() - '0');
+            if (v > max) {
+                fail_at(line, col, what + " out of range (max " + to_string(max) + ")");
+            }
+            advance();
+        }
+        return int(v);
+    }
+
+    void fail(const string& msg) const {
+        fail_at(line_, col_, msg);
+    }
+
+    void fail_at(int line, int col, const string& msg) const {
+        throw invalid_argument(source_ + ":" + to_string(line) + ":" + to_string(col) +
+                               ": Bad encoding formatting: " + msg);
+    }
+
+private:
+    const char* buf_;
+    size_t len_;
+    size_t pos_;
+    int line_;
+    int col_;
+    const string& source_;
+};
+
+}
+
+GOC::GOC() : num_end_states_(0), p1_wins_(0), p2_wins_(0), progress_(new Progress()),
+             table_(new NimberTable()), hint_budget_ms_(1000), lazy_calls_(0), wide_kernel_(false) {
+    /* nothing */
+}
+
+GOC::GOC(string& encoding_file_path) : GOC() {
     cout << "reading encoding..." << endl;
-    // read in encoding
-    fstream board_encoding(encoding_file_path, ios::in);
-    string line;
+    string buf;
+    read_file(encoding_file_path, buf);
+    parse_encoding(buf.data(), buf.size(), encoding_file_path);
 
-    // check file opens
-    if (!board_encoding.is_open()) {
-        throw invalid_argument("Unable to open " + encoding_file_path);
+    cout << "...game board initialized\n" << endl;
+}
+
+GOC::~GOC() {
+    if (progress_ && progress_->running.load()) {
+        progress_->cancel_requested.store(true);
+        progress_->worker_done.wait();
+    }
+}
+
+GOC::Tree::~Tree() {
+    for (auto& level : levels) {
+        for (Node* n : level) {
+            delete n;
+        }
+    }
+}
+
+vector<GOC> GOC::load_boards(const vector<string>& encoding_file_paths) {
+    vector<GOC> boards;
+    boards.reserve(encoding_file_paths.size());
+
+    string buf;     // shared across files
+    for (auto& path : encoding_file_paths) {
+        read_file(path, buf);
+        boards.push_back(GOC());
+        boards.back().parse_encoding(buf.data(), buf.size(), path);
     }
 
-    // read in number nodes/edges
-    getline(board_encoding, line);
-    board_name_ = line;
+    return boards;
+}
+
+void GOC::parse_encoding(const char* buf, size_t len, const string& source) {
+    EncodingReader r(buf, len, source);
 
-    getline(board_encoding, line);
-    pair<short int, short int> p = edges_parser(line);
-    edges_ = vector<pair<short int,short int>>();
-    vertex_degrees_ = vector<short int>(p.first);
+    // board name
+    if (r.at_end()) {
+        r.fail("empty encoding");
+    }
+    board_name_ = r.rest_of_line();
+
+    // number vertices/edges
+    r.skip_blank_lines();
+    int num_vertices = r.read_uint(SHRT_MAX, "number of vertices");
+    r.skip_blanks();
+    int num_edges_line = r.line();
+    int num_edges_col = r.col();
+    int num_edges = r.read_uint(SHRT_MAX, "number of edges");
+    r.expect_eol();
+    if (num_vertices == 0) {
+        r.fail_at(num_edges_line, 1, "board has no vertices");
+    }
+    if (num_edges > MAX_EDGES) {
+        r.fail_at(num_edges_line, num_edges_col, to_string(num_edges) + " edges exceeds the maximum of " +
+                  to_string(MAX_EDGES) + " supported by the state hash");
+    }
 
     // formatting check
-    getline(board_encoding, line);
-    if (line != "EDGES") {
-        throw invalid_argument("Incorrect formatting.");       
-    }   
-
-    // load edges 
-    getline(board_encoding, line);
-    while (line != "CYCLES") {
-        p = edges_parser(line);
-        edges_.push_back(p);
-        vertex_degrees_[p.first]++;
-        vertex_degrees_[p.second]++;
-
-        getline(board_encoding, line);
-    }
-    
+    r.skip_blank_lines();
+    if (!r.match_keyword("EDGES")) {
+        r.fail("expected \"EDGES\"");
+    }
+
+    // load edges
+    edges_.clear();
+    edges_.reserve(num_edges);
+    vertex_degrees_ = vector<short int>(num_vertices);
+    while (true) {
+        r.skip_blank_lines();
+        if (r.at_end()) {
+            r.fail("expected \"CYCLES\" before end of file");
+        }
+        int line = r.line();
+        if (r.match_keyword("CYCLES")) {
+            if (int(edges_.size()) != num_edges) {
+                r.fail_at(line, 1, "expected " + to_string(num_edges) + " edges, found " + to_string(edges_.size()));
+            }
+            break;
+        }
+        if (int(edges_.size()) == num_edges) {
+            r.fail("more than " + to_string(num_edges) + " edges (missing \"CYCLES\"?)");
+        }
+
+        short int u = r.read_uint(num_vertices-1, "start vertex");
+        r.skip_blanks();
+        int col = r.col();
+        short int v = r.read_uint(num_vertices-1, "end vertex");
+        if (u == v) {
+            r.fail_at(line, col, "edge " + to_string(edges_.size()) + " is a loop at vertex " + to_string(u));
+        }
+        r.expect_eol();
+
+        edges_.push_back(pair<short int, short int>(u, v));
+        vertex_degrees_[u]++;
+        vertex_degrees_[v]++;
+    }
+    pow3_ = vector<int>(num_edges);
+    for (int e = 0; e < num_edges; e++) {
+        pow3_[e] = (e == 0) ? 1 : 3*pow3_[e-1];
+    }
+
     // load cycle cells
-    while(getline(board_encoding, line)) {
-        vector<pair<short int, bool>> cycle = cycles_parser(line);
+    cycle_cells_.clear();
+    vector<int> cells_per_edge = vector<int>(num_edges);
+    // scratch space for closure check; entries reset after each cell
+    vector<short int> balance = vector<short int>(num_vertices);   // edges leaving minus edges entering
+    vector<bool> in_cell = vector<bool>(num_edges);
+    while (true) {
+        r.skip_blank_lines();
+        if (r.at_end()) {
+            break;
+        }
+        int line = r.line();
+        vector<pair<short int, bool>> cycle;
+
+        while (!r.at_eol()) {
+            int col = r.col();
+            bool orientation;
+            if (r.peek() == '+') {
+                orientation = true;
+            } else if (r.peek() == '-') {
+                orientation = false;
+            } else {
+                r.fail("expected '+' or '-' before edge index");
+            }
+            r.advance();
+            short int e = r.read_uint(num_edges-1, "edge index");
+            if (in_cell[e]) {
+                r.fail_at(line, col, "edge " + to_string(e) + " appears twice in cell");
+            }
+            if (++cells_per_edge[e] > 2) {
+                r.fail_at(line, col, "edge " + to_string(e) + " borders more than two cells");
+            }
+            in_cell[e] = true;
+            cycle.push_back(pair<short int, bool>(e, orientation));
+            r.skip_blanks();
+        }
+        r.next_line();
+
+        // a closed walk enters each vertex as often as it leaves it...
+        string err;
+        for (auto cyc_edge : cycle) {
+            pair<short int, short int> edge = edges_[cyc_edge.first];
+            short int d = cyc_edge.second ? 1 : -1;
+            balance[edge.first] += d;
+            balance[edge.second] -= d;
+        }
+        for (auto cyc_edge : cycle) {
+            pair<short int, short int> edge = edges_[cyc_edge.first];
+            short int v = balance[edge.first] != 0 ? edge.first : edge.second;
+            if (err.empty() && balance[v] != 0) {
+                err = "orientations inconsistent at vertex " + to_string(v) + " (cell is not a closed walk)";
+            }
+        }
+        // ...and its edges are connected
+        if (err.empty()) {
+            vector<bool> reached = vector<bool>(cycle.size());
+            reached[0] = true;
+            int num_reached = 1;
+            bool grew = true;
+            while (grew) {
+                grew = false;
+                for (int i = 0; i < int(cycle.size()); i++) {
+                    if (reached[i]) {
+                        continue;
+                    }
+                    pair<short int, short int> e_i = edges_[cycle[i].first];
+                    for (int j = 0; j < int(cycle.size()); j++) {
+                        pair<short int, short int> e_j = edges_[cycle[j].first];
+                        if (reached[j] && (e_i.first == e_j.first || e_i.first == e_j.second ||
+                                           e_i.second == e_j.first || e_i.second == e_j.second)) {
+                            reached[i] = true;
+                            num_reached++;
+                            grew = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (num_reached != int(cycle.size())) {
+                err = "cell is not a single closed walk";
+            }
+        }
+        for (auto cyc_edge : cycle) {
+            balance[edges_[cyc_edge.first].first] = 0;
+            balance[edges_[cyc_edge.first].second] = 0;
+            in_cell[cyc_edge.first] = false;
+        }
+        if (!err.empty()) {
+            r.fail_at(line, 1, err);
+        }
+
         cycle_cells_.push_back(cycle);
     }
 
-    cout << "...game board initialized\n" << endl;
+    edge_cells_ = vector<vector<int>>(num_edges);
+    for (int c = 0; c < int(cycle_cells_.size()); c++) {
+        for (auto cyc_edge : cycle_cells_[c]) {
+            edge_cells_[cyc_edge.first].push_back(c);
+        }
+    }
 }
 
 void GOC::compute_tree() {
+    require_idle();
+    build_and_publish_tree();
+}
+
+void GOC::build_and_publish_tree() {
     cout << "computing game tree..." << endl;
 
-    num_end_states_ = 0;
-    p1_wins_ = 0;
-    p2_wins_ = 0;
+    begin_stage(BUILDING_TREE);
 
-    head_ = new Node(State());
-    head_->state.markings = vector<short int>(edges_.size());
-    head_->state.outgoing_edges = vector<short int>(vertex_degrees_.size());
-    hash_to_node_[0] = head_;
-    
-    compute_descendants(head_);
+    // built aside: lookups keep using the current tree (if any) meanwhile
+    shared_ptr<Tree> tree = shared_ptr<Tree>(new Tree());
+    // smallest kernel the board fits in
+    bool built;
+    if (narrow_kernel()) {
+        built = build_tree(BoardKernel<uint16_t>(edges_, cycle_cells_), *tree);
+    } else {
+        built = build_tree(BoardKernel<uint32_t>(edges_, cycle_cells_), *tree);
+    }
+    if (!built) {
+        cout << "...tree computation cancelled\n" << endl;
+        return;
+    }
+
+    // publish; none of the new tree's nimbers are evaluated yet
+    progress_->table_ready.store(false);
+    progress_->norm_ready_level.store(INT_MAX);
+    progress_->mis_ready_level.store(INT_MAX);
+    atomic_store(&table_, shared_ptr<NimberTable>(new NimberTable()));
+    {
+        lock_guard<mutex> lock(progress_->stats_lock);
+        level_stats_.clear();
+    }
+    num_end_states_ = tree->num_end_states;
+    p1_wins_ = tree->p1_wins;
+    p2_wins_ = tree->p2_wins;
+    atomic_store(&tree_, tree);
 
     cout << "...tree initialized\n" << endl;
 }
 
-void GOC::compute_descendants(Node* n) {
-    set<pair<short int, bool>> next_moves = legal_moves(n->state);
+bool GOC::narrow_kernel() const {
+    return !wide_kernel_ && int(edges_.size()) <= BoardKernel<uint16_t>::MAX_EDGES;
+}
+
+template <typename Mask>
+void GOC::kernel_moves(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p,
+                       typename BoardKernel<Mask>::Moves* m) {
+    kernel.moves(p, m);
+#ifdef DEBUG
+    // the kernel must agree with the State based rules on every move and on which ones cycle a cell
+    State s;
+    if (!state_from_hash(p.hash, &s)) {
+        throw logic_error("BoardKernel: position " + to_base_3(p.hash) + " is not reachable");
+    }
+    Mask pos = 0;
+    Mask neg = 0;
+    Mask pos_cycles = 0;
+    Mask neg_cycles = 0;
+    for (auto move : legal_moves(s)) {
+        Mask b = Mask(Mask(1) << move.first);
+        (move.second ? pos : neg) |= b;
+        take_turn(move, &s);
+        if (s.game_over) {
+            (move.second ? pos_cycles : neg_cycles) |= b;
+        }
+        undo_turn(move, &s);
+    }
+    if (pos != m->pos || neg != m->neg || pos_cycles != m->pos_cycles || neg_cycles != m->neg_cycles) {
+        throw logic_error("BoardKernel: moves of position " + to_base_3(p.hash) + " differ from legal_moves");
+    }
+#endif
+}
+
+template <typename Mask>
+bool GOC::build_tree(const BoardKernel<Mask>& kernel, Tree& tree) {
+    typedef typename BoardKernel<Mask>::Position Position;
+
+    tree.head = new Node(0, 0, false);
+    tree.hash_to_node[0] = tree.head;
+    tree.levels.push_back(vector<Node*>(1, tree.head));
+    vector<Position> positions = vector<Position>(1, kernel.root());
+
+    // for estimating remaining states: level k holds at most C(|E|,k)*2^k states
+    int num_edges = edges_.size();
+    vector<double> level_bound = vector<double>(num_edges+1);
+    level_bound[0] = 1;
+    for (int k = 1; k <= num_edges; k++) {
+        level_bound[k] = level_bound[k-1] * 2 * (num_edges-k+1) / k;
+    }
+
+    // expand one level at a time; every child of a level-k state is on level k+1
+    while (true) {
+        vector<Node*> next_level;
+        vector<Position> next_positions;
+        vector<Node*>& level = tree.levels.back();
+        for (size_t i = 0; i < level.size(); i++) {
+            if (cancelled()) {
+                tree.levels.push_back(next_level);  // so the tree frees these too
+                return false;
+            }
+            compute_descendants(kernel, tree, level[i], positions[i], next_level, next_positions);
+        }
+        progress_->states_discovered.store(tree.hash_to_node.size());
+
+        // extrapolate from how full the last level is relative to its bound
+        int k = tree.levels.size()-1;
+        double fill = tree.levels.back().size() / level_bound[k];
+        double remaining = 0;
+        for (int j = k+2; j <= num_edges; j++) {
+            remaining += fill * level_bound[j];
+        }
+        report_level(next_level.empty() ? 0 : (long long)(next_level.size() + remaining));
+
+        if (next_level.empty()) {
+            return true;
+        }
+        tree.levels.push_back(next_level);
+        positions.swap(next_positions);
+    }
+}
+
+template <typename Mask>
+void GOC::compute_descendants(const BoardKernel<Mask>& kernel, Tree& tree, Node* n,
+                              const typename BoardKernel<Mask>::Position& p, vector<Node*>& next_level,
+                              vector<typename BoardKernel<Mask>::Position>& next_positions) {
+    // all moves of n and whether they end the game, in one pass
+    typename BoardKernel<Mask>::Moves moves;
+    kernel_moves(kernel, p, &moves);
     // quick check for board w/ no remaining moves and update game_over flag
-    if (next_moves.empty()) {
-        n->state.game_over = true;
+    if ((moves.pos | moves.neg) == 0) {
+        n->game_over = true;
     }
     // check for end states
-    if (n->state.game_over) {
-        num_end_states_++;
+    if (n->game_over) {
+        tree.num_end_states++;
         
-        if (n->state.turn % 2 == 0) {
-            p2_wins_++;
+        if (n->turn % 2 == 0) {
+            tree.p2_wins++;
         } else {
-            p1_wins_++;
+            tree.p1_wins++;
         }
 
         return;     // no descendants
     }
 
-    // n is an internal state: for each available move check the resulting state...
-    for (auto move : next_moves) {
-        int h = n->state.hash;
-        
-        // find h corr. with resulting state
-        if (move.second) {  // positive orientation
-            h += pow(3,move.first);
-        } else {            // negative orientation
-            h += 2*pow(3,move.first);
-        }
+    // n is an internal state: for each available move (by edge, - before +) check the resulting state...
+    for (Mask rest = moves.pos | moves.neg; rest != 0; rest &= rest - 1) {
+        int e = BoardKernel<Mask>::lowest_edge(rest);
+        for (bool positive : { false, true }) {
+            if ((((positive ? moves.pos : moves.neg) >> e) & 1) == 0) {
+                continue;
+            }
+            // find h corr. with resulting state
+            int h = n->hash + move_hash(pair<short int, bool>(e, positive));
+
+            // if h already exists in tree, link it
+            map<int, Node*>::iterator it = tree.hash_to_node.find(h);
+            if (it != tree.hash_to_node.end()) {
+                n->children.push_back(it->second);
+                continue;
+            }
 
-        // if h already exists in tree, link it
-        if (hash_to_node_.find(h) != hash_to_node_.end()) {
-            n->children.push_back(hash_to_node_[h]);
-            continue;
+            // h does not exist so new state should be created; it is expanded with the next level
+            typename BoardKernel<Mask>::Position next = kernel.child(p, e, positive, ((positive ? moves.pos_cycles : moves.neg_cycles) >> e) & 1);
+            Node* child = new Node(h, next.turn, next.game_over);
+            // insert into tree and map
+            n->children.push_back(child);
+            tree.hash_to_node.insert(it, pair<int, Node*>(h, child));
+            next_level.push_back(child);
+            next_positions.push_back(next);
         }
+    }
+}
+
+void GOC::clear_tree() {
+    progress_->table_ready.store(false);
+    progress_->norm_ready_level.store(INT_MAX);
+    progress_->mis_ready_level.store(INT_MAX);
 
-        // h does not exist so new state should be created and eval'd from
-        State next_state = n->state;
-        take_turn(move, &next_state);
-        Node* child = new Node(next_state);
-        // insert into tree and map
-        n->children.push_back(child);
-        hash_to_node_[h] = child;
-        //recurse
-        compute_descendants(child);
+    atomic_store(&tree_, shared_ptr<Tree>());
+    atomic_store(&table_, shared_ptr<NimberTable>(new NimberTable()));    // views of the old table stay valid
+    {
+        lock_guard<mutex> lock(progress_->stats_lock);
+        level_stats_.clear();
     }
+
+    num_end_states_ = 0;
+    p1_wins_ = 0;
+    p2_wins_ = 0;
 }
 
-set<pair<short int, bool>> GOC::legal_moves(State s) {
+vector<pair<short int, bool>> GOC::legal_moves(const State& s) {
+    vector<pair<short int, bool>> moves;
     if (s.game_over) {
-        return set<pair<short int, bool>>();
+        return moves;
     }
 
-    set<pair<short int, bool>> moves = set<pair<short int, bool>>();
     for (int i = 0; i < int(edges_.size()); i++) {
-        // check if already marked
-        if (s.markings[i] != 0) {
-            continue;
-        }
-        short int u = edges_[i].first;
-        short int v = edges_[i].second;
-        // check legality of positive orientation
-        if (s.outgoing_edges[u] != vertex_degrees_[u]-1 &&
-            s.outgoing_edges[v] != -(vertex_degrees_[v]-1)) {
-            moves.insert(pair<short int, bool>(i,true));
+        // negative orientation first, matching pair ordering
+        pair<short int, bool> neg = pair<short int, bool>(i, false);
+        pair<short int, bool> pos = pair<short int, bool>(i, true);
+        if (is_legal(s, neg)) {
+            moves.push_back(neg);
         }
-        // check legality of negative orientation
-        if (s.outgoing_edges[u] != -(vertex_degrees_[u]-1) &&
-            s.outgoing_edges[v] != vertex_degrees_[v]-1) {
-            moves.insert(pair<short int, bool>(i,false));
+        if (is_legal(s, pos)) {
+            moves.push_back(pos);
         }
     }
 
     return moves;
 }
 
+bool GOC::is_legal(const State& s, pair<short int, bool> t) {
+    // check if already marked
+    if (s.markings[t.first] != 0) {
+        return false;
+    }
+    short int u = edges_[t.first].first;
+    short int v = edges_[t.first].second;
+    if (t.second) {     // legality of positive orientation
+        return s.outgoing_edges[u] != vertex_degrees_[u]-1 &&
+               s.outgoing_edges[v] != -(vertex_degrees_[v]-1);
+    } else {            // legality of negative orientation
+        return s.outgoing_edges[u] != -(vertex_degrees_[u]-1) &&
+               s.outgoing_edges[v] != vertex_degrees_[v]-1;
+    }
+}
+
 void GOC::take_turn(pair<short int, bool> t, State* s) {
     if (s->markings[t.first] != 0) {    // check bad input (error w/ legal moves)
         throw invalid_argument("Not a legal turn.");
@@ -162,21 +643,33 @@ void GOC::take_turn(pair<short int, bool> t, State* s) {
         s->outgoing_edges[v]++;
     }
 
-    // check for cycle creation
-    if (cell_cycled(s)) {
+    // check for cycle creation (only cells on the new edge can have been completed)
+    if (cell_cycled(s, t.first)) {
         s->game_over = true;
     }
     // update hash and num turns
-    // find h corr. with resulting state
-    if (t.second) {  // positive orientation
-        s->hash += pow(3,t.first);
-    } else {            // negative orientation
-        s->hash += 2*pow(3,t.first);
-    }
+    s->hash += move_hash(t);
 
     s->turn++;
 }
 
+void GOC::undo_turn(pair<short int, bool> t, State* s) {
+    short int u = edges_[t.first].first;
+    short int v = edges_[t.first].second;
+    if (s->markings[t.first] == 1) {     // positive orientation
+        s->outgoing_edges[u]--;
+        s->outgoing_edges[v]++;
+    } else {                             // negative orientation
+        s->outgoing_edges[u]++;
+        s->outgoing_edges[v]--;
+    }
+    s->markings[t.first] = 0;
+
+    s->hash -= move_hash(t);
+    s->game_over = false;
+    s->turn--;
+}
+
 bool GOC::cell_cycled(State* s) {
     // flag for cycle direction
 
@@ -207,256 +700,716 @@ bool GOC::cell_cycled(State* s) {
     return false;
 }
 
-void GOC::mex_rule_normal() {
-    cout << "computing nimbers (normal play)..." << endl;
-
-    Node* root = head_;
-    // using dequeue (double-ended queue) impl. of reverse level order trav.
-    stack<Node*> s;
-    queue<Node*> q;
-
-    map<Node*, bool> seen_node;
-
-    q.push(root);
-    seen_node[root] = true;
-    
-    // traverse nodes in level order, pushing to stack as they are seen...
-    while (!q.empty()) {
-        root = q.front();
-        q.pop();
-        s.push(root);
-        
-        for (auto child : root->children) {
-            if (seen_node.find(child) == seen_node.end()) {
-                seen_node[child] = true;
-                q.push(child);
-            }
+bool GOC::cell_cycled(State* s, short int e) {
+    for (int c : edge_cells_[e]) {
+        if (cell_is_cycled(*s, c)) {
+            return true;
         }
     }
-    // ...then reverse level order trav. is done by popping from stack
-    while (!s.empty()) {
-        root = s.top();
 
-        // compute mex here
-        if (root->state.game_over) {
-            node_to_norm_nimber_[root] = 0;
-        } else {
-            int n = root->children.size();
-            // mex is at most n; vector stores whether numbers less than n included in nimbers of children
-            vector<bool> seen = vector<bool>(n+1);
+    return false;
+}
 
-            for (auto child : root->children) {
-                if (node_to_norm_nimber_[child] < n) {
-                    seen[node_to_norm_nimber_[child]] = true;
-                }
-            }
-            // find mex
-            for (int i = 0; i<=n; i++) {
-                if (!seen[i]) {
-                    node_to_norm_nimber_[root] = i;
-                    break;
-                }
-            }
-        }
+bool GOC::cell_is_cycled(const State& s, int c) {
+    int length = cycle_cells_[c].size();
+    int k = 0;
 
-        s.pop();
+    for (auto cyc_edge : cycle_cells_[c]) {
+        short int m = s.markings[cyc_edge.first];
+        if (m == 0) {
+            break;
+        }
+        k += (cyc_edge.second == (m == 1)) ? 1 : -1;
     }
+    return abs(k) == length;
+}
 
-    cout << "...nimbers evaluated\n" << endl;
+void GOC::mex_rule_normal() {
+    require_idle();
+    mex_rule(true);
 }
 
 void GOC::mex_rule_misere() {
-    cout << "computing nimbers (misere play)..." << endl;
-
-    Node* root = head_;
-    // using dequeue (double-ended queue) impl. of reverse level order trav.
-    stack<Node*> s;
-    queue<Node*> q;
-
-    map<Node*, bool> seen_node;
-
-    q.push(root);
-    seen_node[root] = true;
-    
-    // traverse nodes in level order, pushing to stack as they are seen...
-    while (!q.empty()) {
-        root = q.front();
-        q.pop();
-        s.push(root);
-        
-        for (auto child : root->children) {
-            if (seen_node.find(child) == seen_node.end()) {
-                seen_node[child] = true;
-                q.push(child);
-            }
-        }
-    }
-    // ...then reverse level order trav. is done by popping from stack
-    while (!s.empty()) {
-        root = s.top();
+    require_idle();
+    mex_rule(false);
+}
 
-        // compute mex here
-        if (root->state.game_over) {
-            node_to_mis_nimber_[root] = 1;
-        } else {
-            int n = root->children.size();
-            // mex is at most n; vector stores whether numbers less than n included in nimbers of children
-            vector<bool> seen = vector<bool>(n+1);
+void GOC::mex_rule(bool normal_play) {
+    shared_ptr<Tree> tree = atomic_load(&tree_);
+    if (!tree) {
+        throw invalid_argument("Game tree not yet computed.");
+    }
+    cout << "computing nimbers (" << (normal_play ? "normal" : "misere") << " play)..." << endl;
+    vector<vector<Node*>>& levels = tree->levels;
+    begin_stage(normal_play ? NORMAL_NIMBERS : MISERE_NIMBERS);
+    atomic<int>& ready_level = normal_play ? progress_->norm_ready_level : progress_->mis_ready_level;
+    ready_level.store(INT_MAX);
+
+    long long remaining = tree->hash_to_node.size();
+    {
+        lock_guard<mutex> lock(progress_->stats_lock);
+        level_stats_.resize(levels.size());
+    }
+    // reverse level order: children (level k+1) are always evaluated before their parents (level k)
+    for (int level = int(levels.size())-1; level >= 0; level--) {
+        // counted aside and published with the level, since level_stats may be read meanwhile
+        long long end_states = 0;
+        long long p_positions = 0;
+        vector<long long> histogram;
+
+        int count = 0;
+        for (Node* root : levels[level]) {
+            if ((count++ & 4095) == 0 && cancelled()) {
+                cout << "...nimber computation cancelled" << endl;
+                return;
+            }
 
-            for (auto child : root->children) {
-                if (node_to_mis_nimber_[child] < n) {
-                    seen[node_to_mis_nimber_[child]] = true;
+            int& nimber = normal_play ? root->norm_nimber : root->mis_nimber;
+            // compute mex here
+            if (root->game_over) {
+                nimber = normal_play ? 0 : 1;
+            } else {
+                int n = root->children.size();
+                // mex is at most n; vector stores whether numbers less than n included in nimbers of children
+                vector<bool> seen = vector<bool>(n+1);
+
+                for (auto child : root->children) {
+                    int child_nimber = normal_play ? child->norm_nimber : child->mis_nimber;
+                    if (child_nimber < n) {
+                        seen[child_nimber] = true;
+                    }
                 }
-            }
-            // find mex
-            for (int i = 0; i<=n; i++) {
-                if (!seen[i]) {
-                    node_to_mis_nimber_[root] = i;
-                    break;
+                // find mex
+                for (int i = 0; i<=n; i++) {
+                    if (!seen[i]) {
+                        nimber = i;
+                        break;
+                    }
                 }
             }
-        }
 
-        s.pop();
+            end_states += root->game_over;
+            p_positions += (nimber == 0);
+            if (nimber >= int(histogram.size())) {
+                histogram.resize(nimber+1);
+            }
+            histogram[nimber]++;
+        }
+        // publish: nimbers and statistics of this level may now be read from other threads
+        {
+            lock_guard<mutex> lock(progress_->stats_lock);
+            LevelStats& stats = level_stats_[level];
+            stats.states = levels[level].size();
+            stats.end_states = end_states;
+            (normal_play ? stats.norm_p_positions : stats.mis_p_positions) = p_positions;
+            (normal_play ? stats.norm_nimbers : stats.mis_nimbers).swap(histogram);
+        }
+        ready_level.store(level, memory_order_release);
+        remaining -= levels[level].size();
+        report_level(remaining);
     }
 
     cout << "...nimbers evaluated\n" << endl;
 }
 
 int GOC::hash_to_norm_nimber(int h) {
-    if (hash_to_node_.find(h)==hash_to_node_.end() || node_to_norm_nimber_.find(hash_to_node_[h])==node_to_norm_nimber_.end()) {
+    // holding the tree keeps it alive should a new solve replace it meanwhile
+    shared_ptr<Tree> tree = atomic_load(&tree_);
+    if (!tree) {
+        return table_nimber(h, true);
+    }
+    map<int, Node*>::iterator it = tree->hash_to_node.find(h);
+    if (it == tree->hash_to_node.end() || it->second->turn < progress_->norm_ready_level.load(memory_order_acquire)) {
         return -1;
     }
 
-    return node_to_norm_nimber_[hash_to_node_[h]];
+    return it->second->norm_nimber;
 }
 
 int GOC::hash_to_mis_nimber(int h) {
-    if (hash_to_node_.find(h)==hash_to_node_.end() || node_to_mis_nimber_.find(hash_to_node_[h])==node_to_mis_nimber_.end()) {
+    // holding the tree keeps it alive should a new solve replace it meanwhile
+    shared_ptr<Tree> tree = atomic_load(&tree_);
+    if (!tree) {
+        return table_nimber(h, false);
+    }
+    map<int, Node*>::iterator it = tree->hash_to_node.find(h);
+    if (it == tree->hash_to_node.end() || it->second->turn < progress_->mis_ready_level.load(memory_order_acquire)) {
         return -1;
     }
 
-    return node_to_mis_nimber_[hash_to_node_[h]];
+    return it->second->mis_nimber;
 }
 
-void GOC::play_game(bool normal_play) {
-    // intended for use w/ knowledge of n and p positions
-    if ((normal_play && node_to_norm_nimber_.empty()) || 
-        (!normal_play && node_to_mis_nimber_.empty())) {
-        throw invalid_argument("Nimbers not yet calculated.");
+GOC::Progress::Progress()
+    : stage(IDLE), levels_done(0), states_discovered(0), states_remaining(-1),
+      cancel_requested(false), running(false),
+      table_ready(false), norm_ready_level(INT_MAX), mis_ready_level(INT_MAX) {
+    /* nothing */
+}
+
+void GOC::begin_stage(SolveStage stage) {
+    progress_->stage.store(stage);
+    progress_->levels_done.store(0);
+    progress_->states_remaining.store(-1);
+}
+
+void GOC::report_level(long long states_remaining) {
+    progress_->levels_done++;
+    progress_->states_remaining.store(states_remaining);
+    if (progress_->on_progress) {
+        progress_->on_progress(solve_status());
+    }
+}
+
+GOC::SolveStatus GOC::solve_status() const {
+    SolveStatus status;
+    status.stage = SolveStage(progress_->stage.load());
+    status.levels_done = progress_->levels_done.load();
+    status.states_discovered = progress_->states_discovered.load();
+    status.states_remaining = progress_->states_remaining.load();
+    return status;
+}
+
+GOC::SolveHandle GOC::solve_async(ProgressCallback on_progress) {
+    if (progress_->running.exchange(true)) {
+        throw invalid_argument("A solve is already running on this board.");
+    }
+    progress_->cancel_requested.store(false);
+    progress_->on_progress = on_progress;
+
+    // detached, so that neither dropping the handle nor its future blocks until the solve ends
+    shared_ptr<promise<void>> done = shared_ptr<promise<void>>(new promise<void>());
+    SolveHandle handle;
+    handle.progress_ = progress_;
+    handle.done_ = done->get_future().share();
+    progress_->worker_done = handle.done_;
+    shared_ptr<Progress> progress = progress_;
+    thread([this, progress, done]() {
+        exception_ptr error;
+        try {
+            build_and_publish_tree();
+            if (!cancelled()) {
+                mex_rule(true);
+            }
+            if (!cancelled()) {
+                mex_rule(false);
+            }
+            progress->stage.store(cancelled() ? CANCELLED : DONE);
+        } catch (...) {
+            error = current_exception();
+        }
+        // the callback may own the board, so it is released last: destroying the board in it must
+        // neither find the solve still running nor wait on a promise only this thread can fulfil
+        ProgressCallback on_progress;
+        on_progress.swap(progress->on_progress);
+        progress->running.store(false);
+        // the board may be destroyed from here on (see ~GOC)
+        if (error) {
+            done->set_exception(error);
+        } else {
+            done->set_value();
+        }
+    }).detach();
+
+    return handle;
+}
+
+void GOC::require_idle() const {
+    if (progress_->running.load()) {
+        throw invalid_argument("A solve is already running on this board.");
+    }
+}
+
+bool GOC::SolveHandle::ready() const {
+    return !done_.valid() || done_.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+void GOC::SolveHandle::wait() const {
+    if (done_.valid()) {
+        done_.get();
+    }
+}
+
+void GOC::SolveHandle::cancel() {
+    if (progress_) {
+        progress_->cancel_requested.store(true);
+    }
+}
+
+GOC::SolveStatus GOC::SolveHandle::status() const {
+    SolveStatus status = SolveStatus();
+    if (progress_) {
+        status.stage = SolveStage(progress_->stage.load());
+        status.levels_done = progress_->levels_done.load();
+        status.states_discovered = progress_->states_discovered.load();
+        status.states_remaining = progress_->states_remaining.load();
+    }
+    return status;
+}
+
+vector<pair<short int, bool>> GOC::hash_to_p_moves(int h, bool normal_play) {
+    State s;
+    if ((hash_to_norm_nimber(h) == -1 && hash_to_mis_nimber(h) == -1) || !state_from_hash(h, &s)) {
+        return vector<pair<short int, bool>>();
+    }
+
+    return p_moves(s, normal_play);
+}
+
+void GOC::tabulate_nimbers() {
+    require_idle();
+    shared_ptr<Tree> tree = atomic_load(&tree_);
+    if (!tree) {
+        return;
+    }
+
+    shared_ptr<NimberTable> table = atomic_load(&table_);
+    if (table->hashes.empty()) {
+        table = shared_ptr<NimberTable>(new NimberTable());
+        size_t n = tree->hash_to_node.size();
+        table->hashes.reserve(n);
+        table->levels.reserve(n);
+        // level order, as in nimbers_to_file
+        for (const vector<Node*>& level : tree->levels) {
+            for (Node* node : level) {
+                table->hashes.push_back(node->hash);
+                table->levels.push_back(node->turn);
+            }
+        }
+        table->norm_nimbers = vector<int>(n);
+        table->mis_nimbers = vector<int>(n);
+        atomic_store(&table_, table);
+    }
+
+    // nimber columns are refreshed in place, so existing views see mex results computed since;
+    // rows follow tree->levels, so the nodes are read directly rather than looked up by hash
+    int norm_ready_level = progress_->norm_ready_level.load(memory_order_acquire);
+    int mis_ready_level = progress_->mis_ready_level.load(memory_order_acquire);
+    size_t i = 0;
+    for (const vector<Node*>& level : tree->levels) {
+        for (Node* node : level) {
+            table->norm_nimbers[i] = node->turn < norm_ready_level ? -1 : node->norm_nimber;
+            table->mis_nimbers[i] = node->turn < mis_ready_level ? -1 : node->mis_nimber;
+            i++;
+        }
     }
+}
 
+void GOC::play_game(bool normal_play) {
     cout << "---------------------------- Game of Cycles on " << board_name_ << " Board ----------------------------" << endl;
     if (normal_play) {
-        cout << "** Normal play style **\n" << endl;
+        cout << "** Normal play style **" << endl;
     } else {
-        cout << "** Misere play style **\n" << endl;
+        cout << "** Misere play style **" << endl;
+    }
+    // without the full nimber table, hints come from the on-demand search
+    if (!solved(normal_play)) {
+        cout << "** Hints evaluated on demand (" << hint_budget_ms_ << " ms per move, ? = unknown) **" << endl;
     }
+    cout << endl;
+    cout << "Enter a move as: <edge> <orientation>, with 0 = - & 1 = +" << endl;
+    cout << "Other commands: u = take back, r = redo, j <hash> = jump to position, q = quit\n" << endl;
 
+    // single state updated in place; history holds the moves leading to it
     State game = State();
     game.markings = vector<short int>(edges_.size());
     game.outgoing_edges = vector<short int>(vertex_degrees_.size());
+    vector<pair<short int, bool>> history;
+    vector<pair<short int, bool>> redo;
+
+    vector<pair<short int, bool>> avail_moves = legal_moves(game);
+
+    while (true) {
+        if (game.game_over || avail_moves.empty()) {
+            cout << "*** GAME OVER ***" << endl;
+            cout << "edges marked: " << game.turn << endl;
+            cout << "winner: ";
+            if ((normal_play && game.turn%2==0) ||
+                (!normal_play && game.turn%2==1)) {
+                cout << "player 2" << endl;
+            } else {
+                cout << "player 1" << endl;
+            }
+            cout << "('u' to take back, anything else to finish)" << endl;
+        } else {
+            // display info of game state to console
+            cout << "Turn " << game.turn+1 << ", ";
+            if (game.turn%2 == 0) {
+                cout << "player 1's move:" << endl;
+            } else {
+                cout << "player 2's move:" << endl;
+            }
+
+            cout << "Position: " << to_base_3(game.hash) << endl;
+            // the time budget covers all hints shown for this move; it goes to the moves, since the
+            // nimber of the state is the mex of theirs. Each unknown move gets an equal share of the
+            // time left, and a second pass hands what quick moves left over to the others.
+            chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(hint_budget_ms_);
+            vector<int> nimbers = vector<int>(avail_moves.size(), -1);
+            for (int pass = 0; pass < 2; pass++) {
+                int unknown = count(nimbers.begin(), nimbers.end(), -1);
+                for (size_t i = 0; i < avail_moves.size(); i++) {
+                    if (nimbers[i] != -1) {
+                        continue;
+                    }
+                    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                    hint_deadline_ = deadline > now ? now + (deadline - now) / unknown : deadline;
+                    unknown--;
+                    nimbers[i] = child_nimber(&game, avail_moves[i], normal_play, true);
+                }
+            }
+            bool all_known = count(nimbers.begin(), nimbers.end(), -1) == 0;
+            int nimber = normal_play ? hash_to_norm_nimber(game.hash) : hash_to_mis_nimber(game.hash);
+            if (nimber == -1 && all_known) {
+                // mex, as in mex_rule
+                int n = nimbers.size();
+                vector<bool> seen = vector<bool>(n+1);
+                for (int c : nimbers) {
+                    if (c < n) {
+                        seen[c] = true;
+                    }
+                }
+                nimber = 0;
+                while (seen[nimber]) {
+                    nimber++;
+                }
+                (normal_play ? lazy_norm_memo_ : lazy_mis_memo_).store(game.hash, game.turn, nimber);
+            }
+            cout << "Nimber of game-state: ";
+            if (nimber == -1) {
+                cout << "?" << endl;
+            } else {
+                cout << nimber << endl;
+            }
 
-    set<pair<short int, bool>> avail_moves = legal_moves(game);
+            vector<pair<short int, bool>> to_p;
+            for (size_t i = 0; i < avail_moves.size(); i++) {
+                if (nimbers[i] == 0) {
+                    to_p.push_back(avail_moves[i]);
+                }
+            }
+            cout << "moves written as (edge, orientation):nimber, 0 = - & 1 = +" << endl;
+            cout << "Available moves:     ";
+            print_moves(avail_moves, nimbers);
+            cout << "Moves to p-position: ";
+            print_moves(to_p, vector<int>(to_p.size(), 0));
+            cout << "edge (or command): ";
+        }
 
-    while (!game.game_over && !avail_moves.empty()) {
-        // display info of game state to console
-        cout << "Turn " << game.turn+1 << ", ";
-        if (game.turn%2 == 0) {
-            cout << "player 1's move:" << endl;
-        } else {
-            cout << "player 2's move:" << endl;
+        string cmd;
+        if (!(cin >> cmd)) {
+            break;
         }
 
-        cout << "Nimber of game-state: ";
-        if (normal_play) {
-            cout << hash_to_norm_nimber(game.hash) << endl;
-        } else {
-            cout << hash_to_mis_nimber(game.hash) << endl;
-        }
-
-        cout << "moves written as (edge, orientation), 0 = - & 1 = +" << endl;
-        cout << "Available moves:     ";
-        print_moves(avail_moves);
-        cout << "Moves to p-position: ";
-        print_moves(p_moves(game, normal_play));
-
-        // get player's move
-        short int e;    // edge
-        bool o;         // orientation
-        cout << "edge:        ";
-        cin >> e;
-        cout << "orientation: ";
-        cin >> o;
-
-        pair<short int, bool> m = pair<short int, bool>(e,o);
-        bool legal = (avail_moves.find(m)!=avail_moves.end());
-        // retry input if not a legal move
-        while(!legal) {
-            cout << "Not a legal move. Try again:" << endl;
-            cout << "edge:        ";
-            cin >> e;
-            cout << "orientation: ";
+        if (cmd == "u") {           // take back
+            if (history.empty()) {
+                cout << "Nothing to take back.\n" << endl;
+            } else {
+                undo_turn(history.back(), &game);
+                redo.push_back(history.back());
+                history.pop_back();
+                cout << endl;
+            }
+        } else if (cmd == "r") {    // redo
+            if (redo.empty()) {
+                cout << "Nothing to redo.\n" << endl;
+            } else {
+                take_turn(redo.back(), &game);
+                history.push_back(redo.back());
+                redo.pop_back();
+                cout << endl;
+            }
+        } else if (cmd == "j") {    // jump to position
+            string pos;
+            cin >> pos;
+            int h = from_base_3(pos);
+            State jump = game;
+            if (h == -1 || !state_from_hash(h, &jump) ||
+                (solved(normal_play) && (normal_play ? hash_to_norm_nimber(h) : hash_to_mis_nimber(h)) == -1)) {
+                cout << "Not a reachable position.\n" << endl;
+            } else {
+                game = jump;
+                history.clear();
+                redo.clear();
+                cout << endl;
+            }
+        } else if (game.game_over || avail_moves.empty() || cmd == "q") {
+            break;
+        } else {                    // move
+            int e = -1;
+            string o;
+            cout << "orientation:       ";
             cin >> o;
+            if (!cmd.empty() && cmd.find_first_not_of("0123456789") == string::npos && cmd.size() < 6) {
+                e = stoi(cmd);
+            }
+            pair<short int, bool> m = pair<short int, bool>(e, o == "1");
+            // retry input if not a legal move
+            if (e < 0 || e >= int(edges_.size()) || (o != "0" && o != "1") || !is_legal(game, m)) {
+                cout << "Not a legal move. Try again:\n" << endl;
+                continue;
+            }
+            cout << endl;
 
-            m = pair<short int, short int>(e,o);
-            legal = (avail_moves.find(m)!=avail_moves.end());
+            // update game state w/ player's move; a new move starts a new branch
+            take_turn(m, &game);
+            history.push_back(m);
+            redo.clear();
         }
-        cout << endl;
-
-        // update game state w/ player's move
-        take_turn(m, &game);
 
         avail_moves = legal_moves(game);
     }
+    cout << endl;
 
-    cout << "*** GAME OVER ***" << endl;
-    cout << "edges marked: " << game.turn << endl;
-    cout << "winner: ";
-    if ((normal_play && game.turn%2==0) ||
-        (!normal_play && game.turn%2==1)) {
-        cout << "player 2" << endl;
-    } else {
-        cout << "player 1" << endl;
+}
+
+vector<pair<short int, bool>> GOC::p_moves(State s, bool normal_play) {
+    vector<pair<short int, bool>> p_moves;
+    for (auto move : legal_moves(s)) {
+        if (child_nimber(&s, move, normal_play, false) == 0) {
+            p_moves.push_back(move);
+        }
+    }
+    return p_moves;
+}
+
+void GOC::print_moves(const vector<pair<short int, bool>>& moves, const vector<int>& nimbers) {
+    if (moves.empty()) {
+        cout << "...no moves available...";
+    }
+    for (size_t i = 0; i < moves.size(); i++) {
+        cout << "(" << moves[i].first << ", " << moves[i].second << "):";
+        if (nimbers[i] == -1) {
+            cout << "? ";
+        } else {
+            cout << nimbers[i] << " ";
+        }
     }
     cout << endl;
+}
+
+bool GOC::solved(bool normal_play) {
+    return (normal_play ? progress_->norm_ready_level : progress_->mis_ready_level).load() == 0;
+}
+
+int GOC::child_nimber(State* s, pair<short int, bool> m, bool normal_play, bool search) {
+    int h = s->hash + move_hash(m);
+    int nimber = normal_play ? hash_to_norm_nimber(h) : hash_to_mis_nimber(h);
+    if (nimber != -1 || !search) {
+        return nimber;
+    }
+
+    take_turn(m, s);
+    nimber = lazy_nimber(s, normal_play);
+    undo_turn(m, s);
+    return nimber;
+}
 
+int GOC::lazy_nimber(State* s, bool normal_play) {
+    // smallest kernel the board fits in, as in compute_tree
+    if (narrow_kernel()) {
+        BoardKernel<uint16_t> kernel = BoardKernel<uint16_t>(edges_, cycle_cells_);
+        return kernel_nimber(kernel, kernel.position(s->hash), normal_play);
+    }
+    BoardKernel<uint32_t> kernel = BoardKernel<uint32_t>(edges_, cycle_cells_);
+    return kernel_nimber(kernel, kernel.position(s->hash), normal_play);
 }
 
-set<pair<short int, bool>> GOC::p_moves(State s, bool normal_play) {
-    set<pair<short int, bool>> p_moves;
-    int h = s.hash;
-    for (auto child_node : hash_to_node_[h]->children) {
-        State child_state = child_node->state;
-        if ((normal_play && hash_to_norm_nimber(child_state.hash)==0) ||
-            (!normal_play && hash_to_mis_nimber(child_state.hash)==0)) {
-            p_moves.insert(hash_to_move(child_state.hash - h));
+template <typename Mask>
+int GOC::kernel_nimber(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p, bool normal_play) {
+    NimberCache& memo = normal_play ? lazy_norm_memo_ : lazy_mis_memo_;
+    int cached = memo.lookup(p.hash);
+    if (cached != -1) {
+        return cached;
+    }
+    // reading the clock is comparatively slow, so only check it every so often
+    if ((++lazy_calls_ & 255) == 0 && chrono::steady_clock::now() > hint_deadline_) {
+        return -1;
+    }
+
+    int nimber;
+    typename BoardKernel<Mask>::Moves moves;
+    kernel_moves(kernel, p, &moves);
+    if ((moves.pos | moves.neg) == 0) {     // end state (cycle made or no moves left)
+        nimber = normal_play ? 0 : 1;
+    } else {
+        // mex is at most the number of moves; as in mex_rule
+        bitset<BoardKernel<Mask>::MAX_MOVES+1> seen;
+        for (bool positive : { false, true }) {
+            Mask cycles = positive ? moves.pos_cycles : moves.neg_cycles;
+            for (Mask rest = positive ? moves.pos : moves.neg; rest != 0; rest &= rest - 1) {
+                int e = BoardKernel<Mask>::lowest_edge(rest);
+                int c = kernel_nimber(kernel, kernel.child(p, e, positive, (cycles >> e) & 1), normal_play);
+                if (c == -1) {          // out of time; finished subtrees stay memoized
+                    return -1;
+                }
+                seen[c] = true;
+            }
+        }
+        nimber = 0;
+        while (seen[nimber]) {
+            nimber++;
         }
     }
-    return p_moves;
+
+    memo.store(p.hash, p.turn, nimber);
+    return nimber;
 }
 
-pair<short int, bool> GOC::hash_to_move(int h) {
-    short int e = 0;
-    while (h>=3) {
-        h /= 3;
-        e++;
+int GOC::table_nimber(int h, bool normal_play) {
+    if (!progress_->table_ready.load(memory_order_acquire)) {
+        return -1;
+    }
+
+    // rows are sorted by (level, hash); the level of a state is its number of marked edges
+    short int level = 0;
+    for (int d = h; d > 0; d /= 3) {
+        level += (d % 3 != 0);
+    }
+    shared_ptr<NimberTable> held = atomic_load(&table_);
+    const NimberTable& table = *held;
+    size_t lo = 0;
+    size_t hi = table.hashes.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (table.levels[mid] < level || (table.levels[mid] == level && table.hashes[mid] < h)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    if (h==1) {     // pos. orientation
-        return pair<short int, bool>(e, true);
-    } else {        // neg. orientation
-        return pair<short int, bool>(e, false);
+    if (lo == table.hashes.size() || table.hashes[lo] != h) {
+        return -1;
     }
+
+    return normal_play ? table.norm_nimbers[lo] : table.mis_nimbers[lo];
 }
 
-void GOC::print_moves(set<pair<short int, bool>> moves) {
-    if (moves.empty()) {
-        cout << "...no moves available...";
+bool GOC::state_from_hash(int h, State* s) {
+    State state = State();
+    state.markings = vector<short int>(edges_.size());
+    state.outgoing_edges = vector<short int>(vertex_degrees_.size());
+    // replay the markings; which cells end up cycled does not depend on the order
+    for (int e = 0; e < int(edges_.size()); e++, h /= 3) {
+        if (h % 3 == 0) {
+            continue;
+        }
+        pair<short int, bool> m = pair<short int, bool>(e, h % 3 == 1);
+        if (!is_legal(state, m)) {
+            return false;
+        }
+        take_turn(m, &state);
+    }
+    // the move which ended the game lies on every cycled cell
+    int num_cycled = 0;
+    vector<int> cycled_cells = vector<int>(edges_.size());    // per edge
+    for (int c = 0; c < int(cycle_cells_.size()); c++) {
+        if (cell_is_cycled(state, c)) {
+            num_cycled++;
+            for (auto cyc_edge : cycle_cells_[c]) {
+                cycled_cells[cyc_edge.first]++;
+            }
+        }
     }
-    for (auto move : moves) {
-        cout << "(" << move.first << ", " << move.second << ") ";
+    if (num_cycled > 0 && find(cycled_cells.begin(), cycled_cells.end(), num_cycled) == cycled_cells.end()) {
+        return false;
     }
-    cout << endl;
+    state.game_over = num_cycled > 0;
+
+    *s = state;
+    return true;
+}
+
+void GOC::set_hint_budget(int ms) {
+    hint_budget_ms_ = ms;
+}
+
+int GOC::compute_nimber(bool normal_play) {
+    State root = State();
+    root.markings = vector<short int>(edges_.size());
+    root.outgoing_edges = vector<short int>(vertex_degrees_.size());
+
+    hint_deadline_ = chrono::steady_clock::time_point::max();
+    return lazy_nimber(&root, normal_play);
+}
+
+void GOC::set_memo_capacity(size_t entries) {
+    lazy_norm_memo_.reset(entries);
+    lazy_mis_memo_.reset(entries);
+}
+
+NimberCache::Stats GOC::memo_stats(bool normal_play) const {
+    return normal_play ? lazy_norm_memo_.stats() : lazy_mis_memo_.stats();
+}
+
+bool GOC::compute_outcome(bool normal_play) {
+    return hash_to_outcome(0, normal_play) == 1;
+}
+
+int GOC::hash_to_outcome(int h, bool normal_play) {
+    State s;
+    int num_hashes = pow3_.empty() ? 1 : 3 * pow3_.back();
+    if (h < 0 || h >= num_hashes || !state_from_hash(h, &s)) {
+        return -1;
+    }
+
+    OutcomeTable& table = normal_play ? norm_outcomes_ : mis_outcomes_;
+    if (table.known.empty()) {
+        table.known = vector<bool>(num_hashes);
+        table.n_position = vector<bool>(num_hashes);
+    }
+    // smallest kernel the board fits in, as in compute_tree
+    if (narrow_kernel()) {
+        BoardKernel<uint16_t> kernel = BoardKernel<uint16_t>(edges_, cycle_cells_);
+        return kernel_outcome(kernel, kernel.position(h), table, normal_play);
+    }
+    BoardKernel<uint32_t> kernel = BoardKernel<uint32_t>(edges_, cycle_cells_);
+    return kernel_outcome(kernel, kernel.position(h), table, normal_play);
+}
+
+template <typename Mask>
+bool GOC::kernel_outcome(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p,
+                         OutcomeTable& table, bool normal_play) {
+    if (table.known[p.hash]) {
+        return table.n_position[p.hash];
+    }
+
+    bool n_position = false;
+    typename BoardKernel<Mask>::Moves moves;
+    kernel_moves(kernel, p, &moves);
+    if ((moves.pos | moves.neg) == 0) {
+        // end state: the player to move has lost under normal play and won under misere play
+        n_position = !normal_play;
+    } else if (normal_play && (moves.pos_cycles | moves.neg_cycles) != 0) {
+        // cycling a cell ends the game with a win
+        n_position = true;
+    } else {
+        // cycling a cell never wins under misere play (it leaves an end state, an n-position),
+        // so only the other moves need checking: first those to known p-positions, then the rest
+        Mask pos_moves = moves.pos & ~moves.pos_cycles;
+        Mask neg_moves = moves.neg & ~moves.neg_cycles;
+        for (int pass = 0; pass < 2 && !n_position; pass++) {
+            for (bool positive : { false, true }) {
+                for (Mask rest = positive ? pos_moves : neg_moves; rest != 0 && !n_position; rest &= rest - 1) {
+                    typename BoardKernel<Mask>::Position child = kernel.child(p, BoardKernel<Mask>::lowest_edge(rest), positive, false);
+                    if (pass == 0) {
+                        n_position = table.known[child.hash] && !table.n_position[child.hash];
+                    } else {
+                        n_position = !kernel_outcome(kernel, child, table, normal_play);
+                    }
+                }
+            }
+        }
+    }
+
+    table.known[p.hash] = true;
+    table.n_position[p.hash] = n_position;
+    table.evaluated++;
+    return n_position;
+}
+
+size_t GOC::outcome_states(bool normal_play) const {
+    return (normal_play ? norm_outcomes_ : mis_outcomes_).evaluated;
 }
 
 void GOC::nimbers_to_file() {
@@ -471,81 +1424,35 @@ void GOC::nimbers_to_file() {
         file.open(f_path, ios_base::out);
     }
     file << "LEVEL HASH NIMBER" << endl;
-    queue<Node*> q;
-    map<Node*, bool> seen;
-    q.push(head_);
-    seen[head_] = true;
-    while (!q.empty()) {
-        Node* n = q.front();
-        for (Node* child : n->children) {
-            if (seen.find(child)==seen.end()) {
-                seen[child] = true;
-                q.push(child);
-            }
-        }
-        file << n->state.turn << " " << to_base_3(n->state.hash) << " " << node_to_norm_nimber_[n] << endl;
-        q.pop();
+    tabulate_nimbers();
+    shared_ptr<NimberTable> held = atomic_load(&table_);
+    const NimberTable& table = *held;
+    for (size_t i = 0; i < table.hashes.size(); i++) {
+        file << table.levels[i] << " " << to_base_3(table.hashes[i]) << " " << table.norm_nimbers[i] << endl;
     }
 }
 
 string GOC::to_base_3(int h) {
     string s = "";
-    for (int i=0; i<edges_.size(); i++) {
+    for (int i=0; i<int(edges_.size()); i++) {
         s = to_string(h%3)+s;
         h/=3;
     }
     return s;
 }
 
-pair<short int, short int> GOC::edges_parser(string& l) {
-    pair<short int, short int> p = pair<short int, short int>();
-
-    string curr = "";
-    for (unsigned int i = 0; i<l.length(); i++) {
-        if (!isdigit(l[i]) && l[i]!=' ') {
-            throw invalid_argument("Bad encoding formatting.");
-        }
-
-        if (l[i]==' ') {
-            p.first = stoi(l.substr(0,i));
-            p.second = stoi(l.substr(i+1, l.length()-i-1));
-        }
+int GOC::from_base_3(const string& s) {
+    if (s.size() != edges_.size()) {
+        return -1;
     }
-
-    return p;
-}
-
-vector<pair<short int, bool>> GOC::cycles_parser(string& l) {
-    vector<pair<short int, bool>> cycle = vector<pair<short int, bool>>();
-    
-    string curr = "";
-    pair<short int,bool> p = pair<short int,bool>();
-    for (unsigned int i = 0; i<l.length(); i++) {
-        // end of entry
-        if (l[i] == ' ') {
-            p.first = stoi(curr);
-            cycle.push_back(p);
-            curr = "";
-            continue;
-        }
-        // orientation marker
-        if (l[i] == '+') {
-            p.second = true;
-            continue;
-        } else if (l[i] == '-') {
-            p.second = false;
-            continue;
-        }
-        // digits
-        if (!isdigit(l[i])) {
-            throw invalid_argument("Bad encoding formatting.");
+    int h = 0;
+    for (char c : s) {
+        if (c < '0' || c > '2') {
+            return -1;
         }
-        curr += l[i];
+        h = 3*h + (c - '0');
     }
-    p.first = stoi(curr);
-    cycle.push_back(p);
-
-    return cycle;
+    return h;
 }
 
 void GOC::print_info() {
@@ -572,28 +1479,30 @@ void GOC::print_info() {
     }
     cout << endl;
 
-    if (head_ == NULL) {            // gametree not built
+    shared_ptr<Tree> tree = atomic_load(&tree_);
+    bool from_table = progress_->table_ready.load() && !tree;
+    if (!tree && !from_table) {     // gametree not built
         cout << "* Game tree not yet initialized *\n" << endl;
         cout << "-------------------------------------------------------------------------------" << endl;
         return;
     }
     // DISPLAY TREE INFO
     cout << "COMPLETE GAMETREE" << endl;
-    cout << "total game states: " << hash_to_node_.size() <<endl;
+    cout << "total game states: " << (from_table ? atomic_load(&table_)->hashes.size() : tree->hash_to_node.size()) <<endl;
     cout << "total end sates: " << num_end_states_ << endl;
     cout << "player 1 wins: " << p1_wins_ << endl;
     cout << "player 2 wins: " << p2_wins_ << endl;
 
     cout << endl;
 
-    if (node_to_norm_nimber_.empty()) { // nimbers not calculated
-        cout << "* Misere play nimbers not yet evaluated *\n" << endl;
+    if (progress_->norm_ready_level.load() != 0) { // nimbers not calculated
+        cout << "* Normal play nimbers not yet evaluated *\n" << endl;
         cout << "-------------------------------------------------------------------------------" << endl;
         return;
     }
     // DISPLAY NIMBER INFO
     cout << "NIMBERS CALCULATION (NORMAL PLAY):" << endl;
-    int head_nimber = node_to_norm_nimber_[head_];
+    int head_nimber = hash_to_norm_nimber(0);
     cout << "The initial (empty) gameboard has nimber " << head_nimber << " and is therefore ";
     if (head_nimber == 0) {     // head is p-position
         cout << "a p-position,\nso player 2 holds a winning stategy on the " << board_name_ << " gameboard.\n" << endl;
@@ -601,13 +1510,13 @@ void GOC::print_info() {
         cout << "an n-position,\nso player 1 holds a winning stategy on the " << board_name_ << " gameboard.\n" << endl;
     }
 
-    if (node_to_mis_nimber_.empty()) { // nimbers not calculated
-        cout << "* Normal play nimbers not yet evaluated *\n" << endl;
+    if (progress_->mis_ready_level.load() != 0) { // nimbers not calculated
+        cout << "* Misere play nimbers not yet evaluated *\n" << endl;
         cout << "-------------------------------------------------------------------------------" << endl;
         return;
     }
     cout << "NIMBERS CALCULATION (MISERE):" << endl;
-    head_nimber = node_to_mis_nimber_[head_];
+    head_nimber = hash_to_mis_nimber(0);
     cout << "The initial (empty) gameboard has nimber " << head_nimber << " and is therefore ";
     if (head_nimber == 0) {     // head is p-position
         cout << "a p-position,\nso player 2 holds a winning stategy on the " << board_name_ << " gameboard.\n" << endl;
@@ -615,5 +1524,41 @@ void GOC::print_info() {
         cout << "an n-position,\nso player 1 holds a winning stategy on the " << board_name_ << " gameboard.\n" << endl;
     }
 
+    print_level_stats();
+
     cout << "-------------------------------------------------------------------------------" << endl;
-}
\ No newline at end of file
+}
+
+vector<GOC::LevelStats> GOC::level_stats() const {
+    lock_guard<mutex> lock(progress_->stats_lock);
+    return level_stats_;
+}
+
+void GOC::print_level_stats() {
+    vector<LevelStats> level_stats = this->level_stats();
+    if (level_stats.empty()) {
+        cout << "* Level statistics not yet available *\n" << endl;
+        return;
+    }
+
+    cout << "LEVEL STATISTICS (p = p-positions; nimbers as nimber:count)" << endl;
+    cout << "level     states        end  p(normal)  p(misere) | normal nimbers | misere nimbers" << endl;
+    for (size_t level = 0; level < level_stats.size(); level++) {
+        const LevelStats& stats = level_stats[level];
+        cout << setw(5) << level << setw(11) << stats.states << setw(11) << stats.end_states
+             << setw(11) << stats.norm_p_positions << setw(11) << stats.mis_p_positions << " |";
+        for (size_t k = 0; k < stats.norm_nimbers.size(); k++) {
+            if (stats.norm_nimbers[k] > 0) {
+                cout << " " << k << ":" << stats.norm_nimbers[k];
+            }
+        }
+        cout << " |";
+        for (size_t k = 0; k < stats.mis_nimbers.size(); k++) {
+            if (stats.mis_nimbers[k] > 0) {
+                cout << " " << k << ":" << stats.mis_nimbers[k];
+            }
+        }
+        cout << endl;
+    }
+    cout << endl;
+}
@@ -7,14 +7,87 @@
 #include <stack>
 #include <queue>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <stdexcept>
 #include <cmath>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "nimber_cache.h"
 
 using namespace std;
 
+template <typename Mask> class BoardKernel;
+
 class GOC {
+private:
+    struct Progress;
+
+    /*
+     * Differential test of the solvers (goc_fuzz.cpp, make fuzz); compares internal state.
+     */
+    friend class SolverFuzz;
+
 public:
+    /*
+     * Stages of a solve, in the order they run. A cancelled solve ends in CANCELLED.
+     */
+    enum SolveStage { IDLE, BUILDING_TREE, NORMAL_NIMBERS, MISERE_NIMBERS, DONE, CANCELLED };
+
+    /*
+     * Snapshot of solve progress.
+     * levels_done counts the levels finished in the current stage. states_remaining is exact
+     * for the nimber stages and an estimate while the tree is built (-1 when unknown).
+     */
+    struct SolveStatus {
+        SolveStage stage;
+        int levels_done;
+        int states_discovered;
+        long long states_remaining;
+    };
+
+    /*
+     * Called from the solving thread after each finished level.
+     */
+    typedef function<void(const SolveStatus&)> ProgressCallback;
+
+    /*
+     * Handle to a solve running on a worker thread, returned by solve_async.
+     * Dropping the handle neither waits for nor stops the solve; destroying the board cancels it
+     * and waits for the worker.
+     */
+    class SolveHandle {
+    public:
+        /*
+         * Whether the worker has finished (completed, cancelled or failed).
+         */
+        bool ready() const;
+
+        /*
+         * Blocks until the worker finishes; rethrows any exception it raised.
+         */
+        void wait() const;
+
+        /*
+         * Asks the worker to stop at its next check. Results of levels already
+         * finished stay available; a partially built tree is discarded.
+         */
+        void cancel();
+
+        SolveStatus status() const;
+
+    private:
+        friend class GOC;
+        shared_ptr<Progress> progress_;
+        shared_future<void> done_;      // set by the worker thread when it exits
+    };
+
     /*
      * Constructor:
      * Processes graph encoding and initializes edges and cycle cells.
@@ -23,7 +96,29 @@ public:
     GOC(string& encoding_file_path);
 
     /*
-     * Builds out game tree for specific board.
+     * Boards are not copyable: a copy would share the solve progress of the original.
+     * They may be moved (e.g. by load_boards) while no solve runs on them.
+     */
+    GOC(const GOC&) = delete;
+    GOC& operator=(const GOC&) = delete;
+    GOC(GOC&&) = default;
+
+    /*
+     * Cancels a solve still running on the board and waits for its worker to stop.
+     */
+    ~GOC();
+
+    /*
+     * Loads several board encodings in one call.
+     * A single read buffer is reused across files, so large batches of generated boards stay cheap.
+     * Throws invalid_argument (with file:line:column) on the first malformed encoding.
+     */
+    static vector<GOC> load_boards(const vector<string>& encoding_file_paths);
+
+    /*
+     * Builds out game tree for specific board, one level (number of edges marked) at a time.
+     * Throws invalid_argument while a solve is running on the board, as do mex_rule_normal,
+     * mex_rule_misere and tabulate_nimbers.
      */
     void compute_tree();
 
@@ -37,29 +132,166 @@ public:
      */
     void mex_rule_misere();
 
+    /*
+     * Runs compute_tree, mex_rule_normal and mex_rule_misere on a worker thread.
+     * on_progress (optional) is called from that thread after every level.
+     * Only one solve may run on a board at a time. On a board which is already solved, the
+     * previous tree and its nimbers stay readable until the new tree is complete.
+     */
+    SolveHandle solve_async(ProgressCallback on_progress = ProgressCallback());
+
+    /*
+     * Computes normal and misere nimbers of every state with num_workers local worker processes
+     * (at most 64). Each worker owns the states whose hash maps to it and expands them level by
+     * level; frontier states, and then nimbers of child states, are exchanged with the owners
+     * through pipes to this process, which only keeps the resulting nimber table.
+     * No game tree is built: lookups, play_game, print_info and export use the table.
+     */
+    void solve_distributed(int num_workers);
+
+    /*
+     * Progress of the current (or last) solve.
+     */
+    SolveStatus solve_status() const;
+
     /*
      * Returns the number calculated by mex_rule() corr. w/ the unique hash of a game state (normal play).
+     * Returns -1 if that state's nimber is not evaluated (yet). Safe to call while a solve runs:
+     * nimbers become visible level by level as the mex pass finishes them, and a tree being
+     * replaced is only freed once no lookup uses it.
      */
     int hash_to_norm_nimber(int h);
 
     /*
      * Returns the number calculated by mex_rule() corr. w/ the unique hash of a game state (misere play).
+     * Same availability rules as hash_to_norm_nimber.
      */
     int hash_to_mis_nimber(int h);
 
+    /*
+     * Returns the moves from the state with hash h which lead to a p-position.
+     * Only nimbers already evaluated are used: while a solve runs, moves to states whose nimber is
+     * not yet published are left out. Empty if h is not a state of the game tree.
+     */
+    vector<pair<short int, bool>> hash_to_p_moves(int h, bool normal_play);
+
+    /*
+     * Nimber table: one row per game state as parallel columns of
+     * hash, level (edges marked), normal and misere nimber.
+     */
+    struct NimberTable {
+        vector<int> hashes;
+        vector<short int> levels;
+        vector<int> norm_nimbers;
+        vector<int> mis_nimbers;
+    };
+
+    /*
+     * Fills the nimber table with one row per game state, in level order.
+     * Unevaluated nimbers are stored as -1. The rows are built once per game tree and later calls
+     * only refresh the nimber columns in place.
+     */
+    void tabulate_nimbers();
+
+    /*
+     * The current nimber table. A new game tree or solve_distributed replaces the table rather
+     * than modifying it, so a caller holding this pointer (e.g. the NumPy arrays of the python
+     * module) keeps valid columns; they only stop receiving refreshed nimbers.
+     */
+    shared_ptr<const NimberTable> nimber_table() const { return atomic_load(&table_); }
+
+    /*
+     * Per-level statistics of the solved game: number of states, end states and p-positions, and
+     * how many states have each nimber (index = nimber), for both play conventions.
+     */
+    struct LevelStats {
+        long long states;
+        long long end_states;
+        long long norm_p_positions;
+        long long mis_p_positions;
+        vector<long long> norm_nimbers;
+        vector<long long> mis_nimbers;
+
+        LevelStats() : states(0), end_states(0), norm_p_positions(0), mis_p_positions(0) { /* nothing */ }
+    };
+
+    /*
+     * Statistics per level (number of edges marked), accumulated while the nimbers are computed by the
+     * mex rule or solve_distributed; each convention's columns are complete once its nimbers are.
+     * Memory use depends only on the number of levels and nimber values, not on the number of states.
+     * Returns a copy, so it may be called while a solve runs: levels are published as they finish.
+     */
+    vector<LevelStats> level_stats() const;
+
+    /*
+     * Displays level_stats as a table, one line per level; nimber distributions are written as
+     * nimber:count pairs.
+     */
+    void print_level_stats();
+
     /*
      * Displays analysis to terminal.
-     * Shows board info, game tree info, and nimber info
+     * Shows board info, game tree info, nimber info and level statistics
      */
     void print_info();
 
     /*
      * Allows for play of game through terminal.
      * Intended to track winning strategy for player with advantage.
-     * .....more things....
+     * Each available move is shown with the nimber of the state it leads to.
+     * Nimbers not computed (yet) are instead searched for below each move (see set_hint_budget), and
+     * the nimber of the position is the mex of its moves'; results are memoized and reused across
+     * turns and games on this board.
+     * Besides moves, accepts 'u' (take back), 'r' (redo a taken back move),
+     * 'j <ternary hash>' (jump to any solved position) and 'q' (quit).
+     * Moves are made/unmade in place on a single state, so all of these are constant time.
      */
     void play_game(bool normal_play);
 
+    /*
+     * Time spent searching for hints per turn when playing without computed nimbers, shared among
+     * the available moves. Hints not found in time are shown as unknown.
+     */
+    void set_hint_budget(int ms);
+
+    /*
+     * Computes the nimber of the empty board depth-first, without building the game tree.
+     * Only the memo table (see set_memo_capacity) is kept, so memory use can be bounded.
+     */
+    int compute_nimber(bool normal_play);
+
+    /*
+     * Limits each memo table of the depth-first solver (one per play convention) to the given
+     * number of entries (at least 4, one bucket); 0 = unbounded (default). Clears the tables.
+     */
+    void set_memo_capacity(size_t entries);
+
+    /*
+     * Hit rate and eviction counts of the depth-first solver's memo table.
+     */
+    NimberCache::Stats memo_stats(bool normal_play) const;
+
+    /*
+     * Outcome-only solve: whether the empty board is an n-position (the first player wins).
+     * Searches depth-first without computing nimbers, and a state is an n-position as soon as one
+     * move to a p-position is found, so usually only part of the game is visited. Moves which cycle
+     * a cell (immediate wins under normal play) are tried first, then moves to states already known
+     * to be p-positions. Outcomes are kept for the lifetime of the board, two bits per possible hash
+     * (3^|E|/4 bytes per play convention).
+     */
+    bool compute_outcome(bool normal_play);
+
+    /*
+     * Outcome of the state with hash h, evaluated as in compute_outcome:
+     * 1 = n-position, 0 = p-position, -1 if h is not a reachable position.
+     */
+    int hash_to_outcome(int h, bool normal_play);
+
+    /*
+     * Number of states whose outcome compute_outcome/hash_to_outcome have evaluated so far.
+     */
+    size_t outcome_states(bool normal_play) const;
+
     /*
      * Writes nimber data of gameboard to file
      */
@@ -117,29 +349,191 @@ private:
      * Node in game tree.
      */
     struct Node {   
-        State state;
+        /*
+         * As in State; the markings are only needed while the node is expanded (see build_tree).
+         */
+        int hash;
+        short int turn;
+        bool game_over;
+
         vector<Node*> children;
 
-        Node(State s) : state(s), children(vector<Node*>()) { /* nothing */ }
+        /*
+         * For mex rule.
+         * Nimbers for calculating n/p-positions (normal/misere play); -1 until evaluated.
+         */
+        int norm_nimber;
+        int mis_nimber;
+
+        Node(int h, short int t, bool over) : hash(h), turn(t), game_over(over), children(vector<Node*>()),
+                                              norm_nimber(-1), mis_nimber(-1) { /* nothing */ }
+    };
+
+    /*
+     * Game tree built by compute_tree. Nodes are freed with the tree.
+     */
+    struct Tree {
+        /*
+         * Root of tree (empty gameboard).
+         */
+        Node* head;
+
+        /*
+         * For memoization:
+         * Maps unique board state identifier to its corr. node, if its been initialized
+         */
+        map<int, Node*> hash_to_node;
+
+        /*
+         * Nodes grouped by level (number of edges marked), each level in order of discovery.
+         * Children of a level-k node are all on level k+1, so the mex rule can sweep levels bottom-up.
+         */
+        vector<vector<Node*>> levels;
+
+        /*
+         * Basic tree info.
+         */
+        int num_end_states;
+        int p1_wins;
+        int p2_wins;
+
+        Tree() : head(NULL), num_end_states(0), p1_wins(0), p2_wins(0) { /* nothing */ }
+        ~Tree();
+    };
+
+    /*
+     * Solve progress shared with SolveHandles and the worker thread.
+     */
+    struct Progress {
+        atomic<int> stage;
+        atomic<int> levels_done;
+        atomic<int> states_discovered;
+        atomic<long long> states_remaining;
+        atomic<bool> cancel_requested;
+        atomic<bool> running;
+
+        /*
+         * Availability of results to readers on other threads (the tree itself is published through
+         * GOC::tree_): nimbers of states at level >= *_ready_level are final.
+         */
+        atomic<bool> table_ready;   // nimber table from solve_distributed (no tree)
+        atomic<int> norm_ready_level;
+        atomic<int> mis_ready_level;
+
+        /*
+         * Set by solve_async before the worker starts; only called from the worker.
+         */
+        ProgressCallback on_progress;
+
+        /*
+         * Guards GOC::level_stats_, which the worker publishes level by level.
+         */
+        mutex stats_lock;
+
+        /*
+         * Becomes ready when the last worker started by solve_async exits (see ~GOC).
+         */
+        shared_future<void> worker_done;
+
+        Progress();
     };
 
 // helper functions
     /*
-     * For reading board encoding files.
+     * Empty board; used by the public constructor and load_boards before parsing.
+     */
+    GOC();
+
+    /*
+     * Single-pass parser for board encodings held in memory.
+     * Fills edges_, vertex_degrees_ and cycle_cells_, and validates that every cell is a
+     * closed walk with consistent edge orientations. source is only used in error messages.
+     */
+    void parse_encoding(const char* buf, size_t len, const string& source);
+
+    /*
+     * Whether the solvers run on BoardKernel<uint16_t>: boards of at most 16 edges, unless
+     * wide_kernel_ is set. Others run on BoardKernel<uint32_t>.
+     */
+    bool narrow_kernel() const;
+
+    /*
+     * All moves from p, as kernel.moves. Built with DEBUG (e.g. make fuzz_avx2), the result is also
+     * checked against legal_moves and take_turn on the same state; a difference throws logic_error.
+     */
+    template <typename Mask>
+    void kernel_moves(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p,
+                      typename BoardKernel<Mask>::Moves* m);
+
+    /*
+     * Level by level expansion of compute_tree on the given kernel into an empty tree; the positions
+     * of the current level are kept next to its nodes. Returns false if cancelled.
+     */
+    template <typename Mask>
+    bool build_tree(const BoardKernel<Mask>& kernel, Tree& tree);
+
+    /*
+     * Computes the children of given node at position p, linking states already in the tree.
+     * Newly created children and their positions are appended to next_level/next_positions.
+     */
+    template <typename Mask>
+    void compute_descendants(const BoardKernel<Mask>& kernel, Tree& tree, Node* n,
+                             const typename BoardKernel<Mask>::Position& p, vector<Node*>& next_level,
+                             vector<typename BoardKernel<Mask>::Position>& next_positions);
+
+    /*
+     * Body of compute_tree, also run by the solve_async worker: builds a new tree aside and
+     * swaps it in.
+     */
+    void build_and_publish_tree();
+
+    /*
+     * Shared reverse level order pass of mex_rule_normal/mex_rule_misere.
+     */
+    void mex_rule(bool normal_play);
+
+    /*
+     * Drops the game tree and nimber table and resets tree info; the tree is freed once no
+     * lookup still uses it.
+     */
+    void clear_tree();
+
+    /*
+     * Enters a new solve stage and resets per-stage counters.
+     */
+    void begin_stage(SolveStage stage);
+
+    /*
+     * Publishes progress after a finished level and calls the progress callback, if any.
+     */
+    void report_level(long long states_remaining);
+
+    /*
+     * Throws invalid_argument if a solve is running on the board.
+     */
+    void require_idle() const;
+
+    /*
+     * Whether a cancellation was requested for the running solve.
      */
-    pair<short int, short int> edges_parser(string& line);
-    vector<pair<short int, bool>> cycles_parser(string& line);
+    bool cancelled() const { return progress_->cancel_requested.load(memory_order_relaxed); }
 
     /*
-     * Recursively computes game tree headed at given node.
+     * Returns all legal moves from a given game state, ordered by edge then orientation (- before +).
+     * Each pair represents the edge and the orientation to be marked.
      */
-    void compute_descendants(Node* n);
+    vector<pair<short int, bool>> legal_moves(const State& s);
 
     /*
-     * Returns a set of all legal moves from a given game state.
-     * Each element of the set of pairs represents the edge and the orientation to be marked.
+     * Whether move t may be made from s (edge unmarked, no sink/source created).
+     * Does not check s.game_over.
      */
-    set<pair<short int, bool>> legal_moves(State s);
+    bool is_legal(const State& s, pair<short int, bool> t);
+
+    /*
+     * Amount move t adds to the hash of a state.
+     */
+    int move_hash(pair<short int, bool> t) { return (t.second ? 1 : 2) * pow3_[t.first]; }
 
     /*
      * Updates game state according to move t.
@@ -149,29 +543,101 @@ private:
      */
     void take_turn(pair<short int, bool> t, State* s);
 
+    /*
+     * Reverts move t, which must be the last move made on s.
+     * Inverse of take_turn; a state could not be moved from if it was over, so game_over is cleared.
+     */
+    void undo_turn(pair<short int, bool> t, State* s);
+
     /*
      * Checks if a cycle cell exists on the board.
      */
     bool cell_cycled(State* s);
 
     /*
-     * Displays given moves to console.
+     * Checks only the cells bordering edge e.
+     * After marking e, this agrees with cell_cycled as long as no cell was already cycled.
+     */
+    bool cell_cycled(State* s, short int e);
+
+    /*
+     * Whether cell c (index into cycle_cells_) is cycled in s.
+     */
+    bool cell_is_cycled(const State& s, int c);
+
+    /*
+     * Displays given moves to console, each with the nimber of the state it leads to (-1 = unknown).
      * Used by play_game.
      */
-    void print_moves(set<pair<short int, bool>> moves);
+    void print_moves(const vector<pair<short int, bool>>& moves, const vector<int>& nimbers);
 
     /*
-     * Returns set of moves to a game state which is a p-position.
-     * Looks at nimbers of child states of s in game tree.
+     * Returns moves to a game state which is a p-position.
+     * Looks up nimbers of the states reached by each legal move of s; no search is done.
      * normal_play = true means normal nimbers used; false meanse misere nimbers used.
      */
-    set<pair<short int, bool>> p_moves(State s, bool normal_play);
+    vector<pair<short int, bool>> p_moves(State s, bool normal_play);
+
+    /*
+     * Whether every nimber of the given play convention has been computed.
+     */
+    bool solved(bool normal_play);
+
+    /*
+     * Nimber of the state reached from s by move m; s is left unchanged.
+     * Uses the computed nimber if it is published; otherwise, if search is set, lazy_nimber under
+     * the current hint_deadline_. -1 if unknown.
+     */
+    int child_nimber(State* s, pair<short int, bool> m, bool normal_play, bool search);
+
+    /*
+     * On-demand mex rule: evaluates the subtree below s depth-first on the smallest fitting BoardKernel.
+     * Results are memoized in lazy_*_memo_. Returns -1 once hint_deadline_ has passed.
+     */
+    int lazy_nimber(State* s, bool normal_play);
+
+    /*
+     * Depth-first search of lazy_nimber on the given kernel; children are built as copies of p.
+     */
+    template <typename Mask>
+    int kernel_nimber(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p, bool normal_play);
+
+    /*
+     * Outcomes found by compute_outcome, indexed by hash.
+     */
+    struct OutcomeTable {
+        vector<bool> known;
+        vector<bool> n_position;
+        size_t evaluated;
+
+        OutcomeTable() : evaluated(0) { /* nothing */ }
+    };
+
+    /*
+     * Short-circuit search of compute_outcome on the given kernel; returns whether p is an n-position.
+     */
+    template <typename Mask>
+    bool kernel_outcome(const BoardKernel<Mask>& kernel, const typename BoardKernel<Mask>::Position& p,
+                        OutcomeTable& table, bool normal_play);
+
+    /*
+     * Looks up a nimber in the table left by solve_distributed; -1 if absent.
+     */
+    int table_nimber(int h, bool normal_play);
 
     /*
-     * Helper for p_moves.
-     * Given the difference in hashes between a game state and a child state, the corr. move is returned as a pair.
+     * Worker process side of solve_distributed: owns the states assigned to worker id,
+     * reads routed messages from in_fd and writes to out_fd.
      */
-    pair<short int, bool> hash_to_move(int h);
+    void distributed_worker(int id, int num_workers, int in_fd, int out_fd);
+
+    /*
+     * Rebuilds the state with hash h by replaying its markings.
+     * Returns false if h is not a reachable position: a marking would be illegal, or a cell is
+     * cycled without one marked edge lying on every cycled cell (play stops at the first move
+     * which cycles a cell, so that move completes all of them).
+     */
+    bool state_from_hash(int h, State* s);
 
     /*
      * Helper for nimbers_to_file
@@ -179,6 +645,11 @@ private:
      */
     string to_base_3(int h);
 
+    /*
+     * Inverse of to_base_3. Returns -1 if s is not a valid hash string for this board.
+     */
+    int from_base_3(const string& s);
+
 // member vars
     /*
      * Name used to identify game board.
@@ -206,32 +677,66 @@ private:
     vector<short int> vertex_degrees_;
 
     /*
-     * Stores root of tree (empty gameboard).
+     * Cells bordering each edge: edge_cells_[e] lists indices into cycle_cells_.
+     */
+    vector<vector<int>> edge_cells_;
+
+    /*
+     * pow3_[e] = 3^e, the hash weight of edge e.
      */
-    Node* head_;
+    vector<int> pow3_;
 
     /*
-     * Basic tree info.
+     * The game tree; null until compute_tree has built one. Always accessed with atomic_load/atomic_store:
+     * compute_tree builds a new tree aside and swaps it in, and readers on other threads hold on to
+     * the tree they loaded, so a replaced tree is freed by its last user.
+     */
+    shared_ptr<Tree> tree_;
+
+    /*
+     * Basic tree info, of the current tree or from solve_distributed.
      */
     int num_end_states_;
     int p1_wins_;
     int p2_wins_;
 
     /*
-     * For memoization:
-     * Maps unique board state identifier to its corr. node, if its been initialized
+     * Solve progress and result availability (see Progress).
+     */
+    shared_ptr<Progress> progress_;
+
+    /*
+     * Nimber table filled by tabulate_nimbers (see nimber_table); never null. Replaced with
+     * atomic_store, so readers use atomic_load.
+     * After solve_distributed it is the only copy of the results, sorted by (level, hash).
+     */
+    shared_ptr<NimberTable> table_;
+
+    /*
+     * See level_stats. Accessed under progress_->stats_lock.
+     */
+    vector<LevelStats> level_stats_;
+
+    /*
+     * For on-demand hints and compute_nimber (lazy_nimber):
+     * memo tables from state hash to nimber (normal/misere play), kept for the lifetime of the board,
+     * and the time limit for the current move.
      */
-    map<int, Node*> hash_to_node_;
+    NimberCache lazy_norm_memo_;
+    NimberCache lazy_mis_memo_;
+    int hint_budget_ms_;
+    chrono::steady_clock::time_point hint_deadline_;
+    unsigned int lazy_calls_;
 
     /*
-     * For mex rule.
-     * Stores nimbers for calculating n/p-positions (normal play).
+     * Runs every board on BoardKernel<uint32_t>, so that small boards exercise it too (used by the
+     * fuzz test); false by default.
      */
-    map<Node*, int> node_to_norm_nimber_;
+    bool wide_kernel_;
 
     /*
-     * For mex rule.
-     * Stores nimbers for calculating n/p-positions (misere play).
+     * For compute_outcome (normal/misere play); allocated on first use.
      */
-    map<Node*, int> node_to_mis_nimber_;
+    OutcomeTable norm_outcomes_;
+    OutcomeTable mis_outcomes_;
 };
\ No newline at end of file
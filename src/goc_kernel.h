@@ -0,0 +1,415 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Move generation and cycle detection for boards of at most MAX_EDGES edges.
+ * The markings of a state are two edge masks of type Mask (bit e = edge e), and everything the
+ * rules need about the board is precomputed per edge into fixed-size arrays, so a move is a few
+ * word-sized bit operations instead of a walk over per-state vectors.
+ * GOC runs its solvers on the smallest instantiation a board fits in (uint16_t, uint32_t).
+ * Relies on every edge bordering at most two cells, which GOC::parse_encoding enforces.
+ *
+ * The per-edge tables are laid out as lanes (entry e of each array belongs to edge e), so when
+ * built with AVX2 (e.g. make avx2) moves() evaluates every edge of a position at once: all 16
+ * edges of a uint16_t board in one register, a uint32_t board in 8-edge blocks.
+ * Otherwise, and for other Mask types, it loops over the unmarked edges.
+ */
+template <typename Mask>
+class BoardKernel {
+public:
+    static const int MAX_EDGES = 8 * sizeof(Mask);
+
+    /*
+     * Most moves available from a state; nimbers are at most this.
+     */
+    static const int MAX_MOVES = 2 * MAX_EDGES;
+
+    /*
+     * Compact game state; hash, turn and game_over as in GOC::State.
+     * pos/neg: edges marked with positive/negative orientation.
+     */
+    struct Position {
+        Mask pos;
+        Mask neg;
+        int hash;
+        short int turn;
+        bool game_over;
+    };
+
+    /*
+     * Moves from a position, as masks of edges: those which may be marked positively/negatively,
+     * and among them those which cycle a cell (end the game).
+     */
+    struct Moves {
+        Mask pos;
+        Mask neg;
+        Mask pos_cycles;
+        Mask neg_cycles;
+    };
+
+    /*
+     * edges and cells as GOC::edges_ and GOC::cycle_cells_; at most MAX_EDGES edges.
+     */
+    BoardKernel(const vector<pair<short int, short int>>& edges,
+                const vector<vector<pair<short int, bool>>>& cells);
+
+    /*
+     * Empty board.
+     */
+    Position root() const;
+
+    /*
+     * Position with hash h; game_over is set if a cell is cycled.
+     */
+    Position position(int h) const;
+
+    /*
+     * All moves from p; none once p is over.
+     * Built with AVX2 and DEBUG (make fuzz_avx2), the vectorized result is checked against moves_scalar.
+     */
+    void moves(const Position& p, Moves* m) const;
+
+    /*
+     * Reference implementation of moves(), one edge at a time; used by moves() unless vectorized.
+     */
+    void moves_scalar(const Position& p, Moves* m) const;
+
+    /*
+     * Position reached from p by marking edge e (must be legal); cycles as given by moves().
+     */
+    Position child(const Position& p, int e, bool positive, bool cycles) const;
+
+    /*
+     * Lowest edge of a non-empty mask.
+     */
+    static int lowest_edge(Mask m) { return __builtin_ctz(m); }
+
+private:
+    static constexpr int pow3(int e) { return e == 0 ? 1 : 3 * pow3(e - 1); }
+
+    static Mask bit(int e) { return Mask(Mask(1) << e); }
+
+    /*
+     * Whether a cell bordering the marked edge e is cycled.
+     */
+    bool cycles_cell(Mask pos, Mask neg, int e) const;
+
+    /*
+     * AVX2 version of moves(); only defined for the Mask types it is specialized for.
+     */
+    void moves_simd(const Position& p, Moves* m) const;
+
+    int num_edges_;
+    Mask all_edges_;
+    array<int, MAX_EDGES> pow3_;
+
+    /*
+     * For sink/source checking, per edge e = (u,v):
+     * the other edges at u (v), and among all edges at u (v) those leaving it when marked
+     * positively (tail) or entering it (head).
+     * Marking e makes u a source iff every other edge at u already leaves u.
+     */
+    array<Mask, MAX_EDGES> others_u_;
+    array<Mask, MAX_EDGES> others_v_;
+    array<Mask, MAX_EDGES> tail_u_;
+    array<Mask, MAX_EDGES> head_u_;
+    array<Mask, MAX_EDGES> tail_v_;
+    array<Mask, MAX_EDGES> head_v_;
+
+    /*
+     * The (at most) two cells bordering each edge e:
+     * cell_rest_[i][e] holds the other edges of the i-th cell (0 if there is none), and
+     * cell_req_[i][e] those of them which must be marked positively for marking e positively to
+     * cycle the cell. Marking e negatively cycles it iff exactly the others are positive.
+     */
+    array<array<Mask, MAX_EDGES>, 2> cell_rest_;
+    array<array<Mask, MAX_EDGES>, 2> cell_req_;
+};
+
+template <typename Mask>
+BoardKernel<Mask>::BoardKernel(const vector<pair<short int, short int>>& edges,
+                               const vector<vector<pair<short int, bool>>>& cells)
+    : num_edges_(edges.size()), all_edges_(0) {
+    int num_vertices = 0;
+    for (auto edge : edges) {
+        num_vertices = max(num_vertices, max(edge.first, edge.second) + 1);
+    }
+    vector<Mask> tail = vector<Mask>(num_vertices);
+    vector<Mask> head = vector<Mask>(num_vertices);
+    for (int e = 0; e < num_edges_; e++) {
+        tail[edges[e].first] |= bit(e);
+        head[edges[e].second] |= bit(e);
+        all_edges_ |= bit(e);
+    }
+
+    for (int e = 0; e < MAX_EDGES; e++) {
+        pow3_[e] = e < num_edges_ ? pow3(e) : 0;
+        others_u_[e] = others_v_[e] = tail_u_[e] = head_u_[e] = tail_v_[e] = head_v_[e] = 0;
+        cell_rest_[0][e] = cell_rest_[1][e] = cell_req_[0][e] = cell_req_[1][e] = 0;
+    }
+    for (int e = 0; e < num_edges_; e++) {
+        short int u = edges[e].first;
+        short int v = edges[e].second;
+        tail_u_[e] = tail[u];
+        head_u_[e] = head[u];
+        tail_v_[e] = tail[v];
+        head_v_[e] = head[v];
+        others_u_[e] = (tail[u] | head[u]) & ~bit(e);
+        others_v_[e] = (tail[v] | head[v]) & ~bit(e);
+    }
+
+    for (auto& cell : cells) {
+        Mask c = 0;
+        Mask c_pos = 0;
+        for (auto cyc_edge : cell) {
+            c |= bit(cyc_edge.first);
+            if (cyc_edge.second) {
+                c_pos |= bit(cyc_edge.first);
+            }
+        }
+        for (auto cyc_edge : cell) {
+            int e = cyc_edge.first;
+            int i = cell_rest_[0][e] == 0 ? 0 : 1;
+            cell_rest_[i][e] = c & ~bit(e);
+            // e marked along the cell's orientation: the others must follow it, else oppose it
+            cell_req_[i][e] = (cyc_edge.second ? c_pos : Mask(c & ~c_pos)) & ~bit(e);
+        }
+    }
+}
+
+template <typename Mask>
+typename BoardKernel<Mask>::Position BoardKernel<Mask>::root() const {
+    Position p = { 0, 0, 0, 0, false };
+    return p;
+}
+
+template <typename Mask>
+typename BoardKernel<Mask>::Position BoardKernel<Mask>::position(int h) const {
+    Position p = { 0, 0, h, 0, false };
+    for (int e = 0; e < num_edges_ && h > 0; e++, h /= 3) {
+        if (h % 3 == 1) {
+            p.pos |= bit(e);
+        } else if (h % 3 == 2) {
+            p.neg |= bit(e);
+        } else {
+            continue;
+        }
+        p.turn++;
+    }
+    for (Mask rest = p.pos | p.neg; rest != 0 && !p.game_over; rest &= rest - 1) {
+        p.game_over = cycles_cell(p.pos, p.neg, lowest_edge(rest));
+    }
+    return p;
+}
+
+template <typename Mask>
+void BoardKernel<Mask>::moves(const Position& p, Moves* m) const {
+#ifdef __AVX2__
+    moves_simd(p, m);
+#ifdef DEBUG
+    Moves check;
+    moves_scalar(p, &check);
+    if (check.pos != m->pos || check.neg != m->neg ||
+        check.pos_cycles != m->pos_cycles || check.neg_cycles != m->neg_cycles) {
+        throw logic_error("BoardKernel: vectorized moves differ from moves_scalar");
+    }
+#endif
+#else
+    moves_scalar(p, m);
+#endif
+}
+
+template <typename Mask>
+void BoardKernel<Mask>::moves_scalar(const Position& p, Moves* m) const {
+    m->pos = m->neg = m->pos_cycles = m->neg_cycles = 0;
+    if (p.game_over) {
+        return;
+    }
+
+    Mask marked = p.pos | p.neg;
+    for (Mask rest = all_edges_ & ~marked; rest != 0; rest &= rest - 1) {
+        int e = lowest_edge(rest);
+        Mask out_u = (p.pos & tail_u_[e]) | (p.neg & head_u_[e]);
+        Mask in_u = (p.pos & head_u_[e]) | (p.neg & tail_u_[e]);
+        Mask out_v = (p.pos & tail_v_[e]) | (p.neg & head_v_[e]);
+        Mask in_v = (p.pos & head_v_[e]) | (p.neg & tail_v_[e]);
+        // u->v: u must not become a source nor v a sink; v->u conversely
+        bool pos_legal = (others_u_[e] & ~out_u) != 0 && (others_v_[e] & ~in_v) != 0;
+        bool neg_legal = (others_v_[e] & ~out_v) != 0 && (others_u_[e] & ~in_u) != 0;
+        if (pos_legal) {
+            m->pos |= bit(e);
+        }
+        if (neg_legal) {
+            m->neg |= bit(e);
+        }
+
+        for (int i = 0; i < 2; i++) {
+            Mask rest_c = cell_rest_[i][e];
+            if (rest_c == 0 || (rest_c & ~marked) != 0) {
+                continue;
+            }
+            if (pos_legal && (p.pos & rest_c) == cell_req_[i][e]) {
+                m->pos_cycles |= bit(e);
+            }
+            if (neg_legal && (p.pos & rest_c) == (rest_c & ~cell_req_[i][e])) {
+                m->neg_cycles |= bit(e);
+            }
+        }
+    }
+}
+
+#ifdef __AVX2__
+/*
+ * Vectorized moves(): lane e of each register holds edge e, and a lane is all ones where a
+ * condition holds. The scalar expressions of moves_scalar are evaluated lane-wise and the lane
+ * results are collected into edge masks.
+ */
+template <>
+inline void BoardKernel<uint16_t>::moves_simd(const Position& p, Moves* m) const {
+    m->pos = m->neg = m->pos_cycles = m->neg_cycles = 0;
+    if (p.game_over) {
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pos = _mm256_set1_epi16(short(p.pos));
+    const __m256i neg = _mm256_set1_epi16(short(p.neg));
+    const __m256i marked = _mm256_or_si256(pos, neg);
+    // lane-wise x == 0, and the edge mask of the lanes set in x
+    auto is_zero = [&](__m256i x) { return _mm256_cmpeq_epi16(x, zero); };
+    auto lanes = [&](__m256i x) {
+        unsigned int b = _mm256_movemask_epi8(_mm256_packs_epi16(x, zero));
+        return uint16_t((b & 0xff) | ((b >> 8) & 0xff00));
+    };
+    auto load = [](const array<uint16_t, 16>& a) { return _mm256_loadu_si256((const __m256i*)a.data()); };
+
+    __m256i tail_u = load(tail_u_);
+    __m256i head_u = load(head_u_);
+    __m256i tail_v = load(tail_v_);
+    __m256i head_v = load(head_v_);
+    __m256i others_u = load(others_u_);
+    __m256i others_v = load(others_v_);
+    __m256i out_u = _mm256_or_si256(_mm256_and_si256(pos, tail_u), _mm256_and_si256(neg, head_u));
+    __m256i in_u = _mm256_or_si256(_mm256_and_si256(pos, head_u), _mm256_and_si256(neg, tail_u));
+    __m256i out_v = _mm256_or_si256(_mm256_and_si256(pos, tail_v), _mm256_and_si256(neg, head_v));
+    __m256i in_v = _mm256_or_si256(_mm256_and_si256(pos, head_v), _mm256_and_si256(neg, tail_v));
+    // andnot(a, b) = ~a & b
+    __m256i pos_blocked = _mm256_or_si256(is_zero(_mm256_andnot_si256(out_u, others_u)),
+                                          is_zero(_mm256_andnot_si256(in_v, others_v)));
+    __m256i neg_blocked = _mm256_or_si256(is_zero(_mm256_andnot_si256(out_v, others_v)),
+                                          is_zero(_mm256_andnot_si256(in_u, others_u)));
+
+    __m256i pos_cycles = zero;
+    __m256i neg_cycles = zero;
+    for (int i = 0; i < 2; i++) {
+        __m256i rest_c = load(cell_rest_[i]);
+        __m256i req = load(cell_req_[i]);
+        __m256i full = _mm256_andnot_si256(is_zero(rest_c), is_zero(_mm256_andnot_si256(marked, rest_c)));
+        __m256i pos_c = _mm256_and_si256(pos, rest_c);
+        pos_cycles = _mm256_or_si256(pos_cycles, _mm256_and_si256(full, _mm256_cmpeq_epi16(pos_c, req)));
+        neg_cycles = _mm256_or_si256(neg_cycles,
+                                     _mm256_and_si256(full, _mm256_cmpeq_epi16(pos_c, _mm256_andnot_si256(req, rest_c))));
+    }
+
+    uint16_t unmarked = all_edges_ & ~(p.pos | p.neg);
+    m->pos = unmarked & ~lanes(pos_blocked);
+    m->neg = unmarked & ~lanes(neg_blocked);
+    m->pos_cycles = m->pos & lanes(pos_cycles);
+    m->neg_cycles = m->neg & lanes(neg_cycles);
+}
+
+template <>
+inline void BoardKernel<uint32_t>::moves_simd(const Position& p, Moves* m) const {
+    m->pos = m->neg = m->pos_cycles = m->neg_cycles = 0;
+    if (p.game_over) {
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pos = _mm256_set1_epi32(int(p.pos));
+    const __m256i neg = _mm256_set1_epi32(int(p.neg));
+    const __m256i marked = _mm256_or_si256(pos, neg);
+    auto is_zero = [&](__m256i x) { return _mm256_cmpeq_epi32(x, zero); };
+    auto lanes = [](__m256i x) { return uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(x))); };
+
+    uint32_t pos_blocked = 0;
+    uint32_t neg_blocked = 0;
+    uint32_t pos_cycles = 0;
+    uint32_t neg_cycles = 0;
+    // 8 edges per block
+    for (int b = 0; b < num_edges_; b += 8) {
+        auto load = [b](const array<uint32_t, 32>& a) { return _mm256_loadu_si256((const __m256i*)(a.data() + b)); };
+        __m256i tail_u = load(tail_u_);
+        __m256i head_u = load(head_u_);
+        __m256i tail_v = load(tail_v_);
+        __m256i head_v = load(head_v_);
+        __m256i others_u = load(others_u_);
+        __m256i others_v = load(others_v_);
+        __m256i out_u = _mm256_or_si256(_mm256_and_si256(pos, tail_u), _mm256_and_si256(neg, head_u));
+        __m256i in_u = _mm256_or_si256(_mm256_and_si256(pos, head_u), _mm256_and_si256(neg, tail_u));
+        __m256i out_v = _mm256_or_si256(_mm256_and_si256(pos, tail_v), _mm256_and_si256(neg, head_v));
+        __m256i in_v = _mm256_or_si256(_mm256_and_si256(pos, head_v), _mm256_and_si256(neg, tail_v));
+        pos_blocked |= lanes(_mm256_or_si256(is_zero(_mm256_andnot_si256(out_u, others_u)),
+                                             is_zero(_mm256_andnot_si256(in_v, others_v)))) << b;
+        neg_blocked |= lanes(_mm256_or_si256(is_zero(_mm256_andnot_si256(out_v, others_v)),
+                                             is_zero(_mm256_andnot_si256(in_u, others_u)))) << b;
+
+        for (int i = 0; i < 2; i++) {
+            __m256i rest_c = load(cell_rest_[i]);
+            __m256i req = load(cell_req_[i]);
+            __m256i full = _mm256_andnot_si256(is_zero(rest_c), is_zero(_mm256_andnot_si256(marked, rest_c)));
+            __m256i pos_c = _mm256_and_si256(pos, rest_c);
+            pos_cycles |= lanes(_mm256_and_si256(full, _mm256_cmpeq_epi32(pos_c, req))) << b;
+            neg_cycles |= lanes(_mm256_and_si256(full, _mm256_cmpeq_epi32(pos_c, _mm256_andnot_si256(req, rest_c)))) << b;
+        }
+    }
+
+    uint32_t unmarked = all_edges_ & ~(p.pos | p.neg);
+    m->pos = unmarked & ~pos_blocked;
+    m->neg = unmarked & ~neg_blocked;
+    m->pos_cycles = m->pos & pos_cycles;
+    m->neg_cycles = m->neg & neg_cycles;
+}
+#endif
+
+template <typename Mask>
+typename BoardKernel<Mask>::Position BoardKernel<Mask>::child(const Position& p, int e, bool positive, bool cycles) const {
+    Position c = p;
+    if (positive) {
+        c.pos |= bit(e);
+        c.hash += pow3_[e];
+    } else {
+        c.neg |= bit(e);
+        c.hash += 2 * pow3_[e];
+    }
+    c.turn++;
+    c.game_over = cycles;
+    return c;
+}
+
+template <typename Mask>
+bool BoardKernel<Mask>::cycles_cell(Mask pos, Mask neg, int e) const {
+    bool positive = (pos >> e) & 1;
+    for (int i = 0; i < 2; i++) {
+        Mask rest_c = cell_rest_[i][e];
+        if (rest_c == 0 || (rest_c & ~(pos | neg)) != 0) {
+            continue;
+        }
+        if ((pos & rest_c) == (positive ? cell_req_[i][e] : Mask(rest_c & ~cell_req_[i][e]))) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,13 +1,17 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstring>
 
 #include "goc_game_tree.h"
 
 
 using namespace std;
 
-int main(int argc, char** argv) {
+/*
+ * Runs the analysis selected by the command line arguments.
+ */
+int run(int argc, char** argv) {
     /*
      * GENERAL PROCEDURE FOR ANALYSIS OF GAMEBOARD
      * - add board_encoding.txt file for specific board to board_encodings directory following
@@ -20,6 +24,19 @@ int main(int argc, char** argv) {
      * - To compute nimbers, run:
      *         board.mex_rule_normal();
      *         board.mex_rule_misere();
+     * - To play without computing the tree (hints searched for on demand, within a time budget per move):
+     *         board.set_hint_budget(ms);
+     *         board.play_game(normal_play);
+     * - To compute all nimbers with n local worker processes instead (no game tree is kept):
+     *         board.solve_distributed(n);
+     * - To compute only the nimber of the empty board, with memory bounded by a memo table size:
+     *         board.set_memo_capacity(entries);
+     *         board.compute_nimber(normal_play);
+     * - To find only which player wins (no nimbers; stops searching a state once a winning move is found):
+     *         board.compute_outcome(normal_play);
+     * - Per-level counts of states, end states and p-positions and nimber distributions are gathered
+     *   while nimbers are computed (also by solve_distributed); to display them:
+     *         board.print_level_stats();
      * - To get nimber of specific game state, first determine (manually) its unique hash h, ensuring
      *   consistency w/ encoding of board, then run:
      *         board.hash_to_norm_nimber(h);
@@ -58,6 +75,85 @@ int main(int argc, char** argv) {
             cin >> cont;
             cout << endl;
         }
+    } else if (strcmp(argv[2],"lazy")==0) {
+        // play without solving the board first; hints are searched for as the game goes
+        string encoding_file = "../board_encodings/";
+        encoding_file += argv[1];
+
+        GOC board = GOC(encoding_file);
+        if (argc > 3) {
+            board.set_hint_budget(atoi(argv[3]));
+        }
+
+        string cont = "1";
+        while (cont == "0" || cont == "1") {
+            cout << "Initiate game on " << board.name() << " board?" << endl;
+            cout << "Enter '1' for normal play, '0' for misere play, anything else to stop: ";
+            cin >> cont;
+            cout << endl;
+
+            if (cont == "0" || cont == "1") {
+                board.play_game(cont == "1");
+            }
+        }
+    } else if (strcmp(argv[2],"distributed")==0) {
+        // solve with argv[3] worker processes; writes nimbers to file if followed by to_file
+        string encoding_file = "../board_encodings/";
+        encoding_file += argv[1];
+
+        GOC board = GOC(encoding_file);
+        board.solve_distributed(argc > 3 ? atoi(argv[3]) : 2);
+        if (argc > 4 && strcmp(argv[4],"to_file")==0) {
+            board.nimbers_to_file();
+        } else {
+            board.print_info();
+        }
+    } else if (strcmp(argv[2],"bounded")==0) {
+        // solve depth-first with a memo table of at most argv[3] entries (per play convention)
+        string encoding_file = "../board_encodings/";
+        encoding_file += argv[1];
+
+        GOC board = GOC(encoding_file);
+        if (argc > 3) {
+            board.set_memo_capacity(strtoull(argv[3], NULL, 10));
+        }
+
+        for (int normal = 1; normal >= 0; normal--) {
+            int nimber = board.compute_nimber(normal);
+            NimberCache::Stats stats = board.memo_stats(normal);
+            cout << (normal ? "normal" : "misere") << " play: empty board has nimber " << nimber << endl;
+            cout << "memo: " << stats.size << "/";
+            if (stats.capacity == 0) {
+                cout << "unbounded";
+            } else {
+                cout << stats.capacity;
+            }
+            cout << " entries, hit rate " << stats.hit_rate()
+                 << ", evictions " << stats.evictions << "\n" << endl;
+        }
+    } else if (strcmp(argv[2],"outcome")==0) {
+        // winner of the empty board only, for both conventions
+        string encoding_file = "../board_encodings/";
+        encoding_file += argv[1];
+
+        GOC board = GOC(encoding_file);
+        for (int normal = 1; normal >= 0; normal--) {
+            bool first_wins = board.compute_outcome(normal);
+            cout << (normal ? "normal" : "misere") << " play: empty board is "
+                 << (first_wins ? "an n-position (player 1 wins)" : "a p-position (player 2 wins)") << endl;
+            cout << "states evaluated: " << board.outcome_states(normal) << "\n" << endl;
+        }
+    } else if (strcmp(argv[2],"stats")==0) {
+        // level statistics only, without the rest of the analysis
+        string encoding_file = "../board_encodings/";
+        encoding_file += argv[1];
+
+        GOC board = GOC(encoding_file);
+        board.compute_tree();
+        board.mex_rule_normal();
+        board.mex_rule_misere();
+
+        board.print_level_stats();
     } else if (strcmp(argv[2],"to_file")==0) {
         string encoding_file = "../board_encodings/";
         encoding_file += argv[1];
@@ -69,4 +165,16 @@ int main(int argc, char** argv) {
         
         board.nimbers_to_file();
     }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // malformed encodings and bad arguments surface as exceptions; report them instead of aborting
+    try {
+        return run(argc, argv);
+    } catch (const exception& e) {
+        cout << "Error: " << e.what() << endl;
+        return 1;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "nimber_cache.h"
+
+#include <utility>
+
+NimberCache::NimberCache(size_t capacity) {
+    reset(capacity);
+}
+
+void NimberCache::reset(size_t capacity) {
+    unbounded_.clear();
+    table_.clear();
+    size_ = 0;
+    num_buckets_ = 0;
+    capacity_ = 0;
+
+    if (capacity > 0) {
+        // as many whole buckets as fit, but at least one
+        num_buckets_ = capacity < WAYS ? 1 : capacity / WAYS;
+        capacity_ = num_buckets_ * WAYS;
+        Entry empty = { -1, 0, 0 };
+        table_ = vector<Entry>(capacity_, empty);
+    }
+
+    stats_ = Stats();
+    stats_.capacity = capacity_;
+}
+
+size_t NimberCache::bucket(int h) const {
+    // multiplicative hashing spreads the ternary hashes, whose low digits are the first edges; the
+    // high bits of the product then pick the bucket, for any number of buckets
+    uint32_t mixed = uint32_t(h) * 2654435769u;
+    return size_t((uint64_t(mixed) * num_buckets_) >> 32) * WAYS;
+}
+
+int NimberCache::lookup(int h) {
+    stats_.lookups++;
+
+    if (capacity_ == 0) {
+        unordered_map<int, int>::iterator it = unbounded_.find(h);
+        if (it == unbounded_.end()) {
+            return -1;
+        }
+        stats_.hits++;
+        return it->second;
+    }
+
+    size_t b = bucket(h);
+    for (size_t i = b; i < b + WAYS; i++) {
+        if (table_[i].hash == h) {
+            stats_.hits++;
+            return table_[i].nimber;
+        }
+    }
+    return -1;
+}
+
+void NimberCache::store(int h, short int level, int nimber) {
+    stats_.stores++;
+
+    if (capacity_ == 0) {
+        unbounded_[h] = nimber;
+        size_ = unbounded_.size();
+        return;
+    }
+
+    size_t b = bucket(h);
+    Entry entry = { h, level, short(nimber) };
+    // existing entry
+    for (size_t i = b; i < b + WAYS; i++) {
+        if (table_[i].hash == h) {
+            table_[i] = entry;
+            return;
+        }
+    }
+
+    // depth-preferred slots: take a free one, else displace the deepest if it is no shallower
+    size_t victim = b;
+    for (size_t i = b; i < b + WAYS - 1; i++) {
+        if (table_[i].hash == -1) {
+            table_[i] = entry;
+            size_++;
+            return;
+        }
+        if (table_[i].level > table_[victim].level) {
+            victim = i;
+        }
+    }
+    if (table_[victim].level >= level) {
+        swap(entry, table_[victim]);    // displaced entry moves on to the always-replace slot
+    }
+
+    // always-replace slot
+    Entry& last = table_[b + WAYS - 1];
+    if (last.hash == -1) {
+        size_++;
+    } else {
+        stats_.evictions++;
+    }
+    last = entry;
+}
+
+NimberCache::Stats NimberCache::stats() const {
+    Stats s = stats_;
+    s.size = size_;
+    return s;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Memo table from state hash to nimber, used by the depth-first solver (GOC::lazy_nimber).
+ * Unbounded by default. With a capacity, entries live in a fixed set-associative table.
+ * All but one slot of a bucket are depth-preferred: when full, the deepest state gives way, since
+ * states near the root have the largest subtrees and are the most expensive to recompute.
+ * The last slot always takes the newest state that did not get a depth-preferred slot, so the
+ * cheap but frequently revisited deep states still get hits. Cached nimbers are always exact;
+ * a bounded table only trades memory for recomputation.
+ */
+class NimberCache {
+public:
+    /*
+     * Lookup/replacement counters.
+     */
+    struct Stats {
+        long long lookups;
+        long long hits;
+        long long stores;
+        long long evictions;    // cached states dropped to make room
+        size_t size;
+        size_t capacity;        // 0 = unbounded
+
+        double hit_rate() const { return lookups == 0 ? 0 : double(hits) / lookups; }
+    };
+
+    /*
+     * capacity is the maximum number of entries (rounded down to whole buckets, but at least one
+     * bucket of WAYS entries); 0 = unbounded.
+     */
+    NimberCache(size_t capacity = 0);
+
+    /*
+     * Returns the cached nimber of state h, or -1 if it is not cached.
+     */
+    int lookup(int h);
+
+    /*
+     * Caches the nimber of state h, which has the given level (edges marked).
+     */
+    void store(int h, short int level, int nimber);
+
+    /*
+     * Empties the table and sets a new capacity. Resets statistics.
+     */
+    void reset(size_t capacity);
+
+    Stats stats() const;
+
+private:
+    /*
+     * Slot of the bounded table. hash == -1 marks an empty slot.
+     */
+    struct Entry {
+        int hash;
+        short int level;
+        short int nimber;
+    };
+
+    /*
+     * Index of the first slot of the bucket for h.
+     */
+    size_t bucket(int h) const;
+
+    /*
+     * Slots per bucket.
+     */
+    static const size_t WAYS = 4;
+
+    size_t capacity_;
+    size_t size_;
+    size_t num_buckets_;
+    vector<Entry> table_;                // bounded mode
+    unordered_map<int, int> unbounded_;  // unbounded mode
+    Stats stats_;
+};